@@ -4,9 +4,15 @@
  * Updated for Arduino 1.5.7 18 July 2014
  *
  * No memory is consumed in the sketch if your code does not call any of the string methods
- * You can change the text of the strings, make sure the short strings are each exactly 3 characters 
- * the long strings can be any length up to the constant dt_MAX_STRING_LEN defined in TimeLib.h
- * 
+ * The names come from a dateLocale_t, English unless setDateLocale() selects another table.
+ * monthName() and the other name functions return views into the table, the older monthStr()
+ * functions return null terminated strings and only copy on AVR, where the table is in flash.
+ *
+ * monthFromName() and dayFromName() look names up in a perfect hash table built for the locale:
+ * each name hashes to one of a few buckets, and each bucket has a displacement that was chosen
+ * so all names land in different slots. A lookup is one hash, one slot and one compare.
+ * The table for English is computed ahead and is there from the start; setDateLocale() builds
+ * the table for any other locale, so lookups only ever read it and are safe from any thread.
  */
 
 #include <Arduino.h>
@@ -19,14 +25,9 @@
 #define PROGMEM
 #endif
 
+#include <string.h>
 #include "TimeLib.h"
 
- 
-// the short strings for each day or month must be exactly dt_SHORT_STR_LEN
-#define dt_SHORT_STR_LEN  3 // the length of short strings
-
-static char buffer[dt_MAX_STRING_LEN+1];  // must be big enough for longest string and the terminating null
-
 const char monthStr0[] PROGMEM = "";
 const char monthStr1[] PROGMEM = "January";
 const char monthStr2[] PROGMEM = "February";
@@ -47,7 +48,25 @@ const PROGMEM char * const PROGMEM monthNames_P[] =
     monthStr7,monthStr8,monthStr9,monthStr10,monthStr11,monthStr12
 };
 
-const char monthShortNames_P[] PROGMEM = "ErrJanFebMarAprMayJunJulAugSepOctNovDec";
+const char monthShortStr0[] PROGMEM = "Err";
+const char monthShortStr1[] PROGMEM = "Jan";
+const char monthShortStr2[] PROGMEM = "Feb";
+const char monthShortStr3[] PROGMEM = "Mar";
+const char monthShortStr4[] PROGMEM = "Apr";
+const char monthShortStr5[] PROGMEM = "May";
+const char monthShortStr6[] PROGMEM = "Jun";
+const char monthShortStr7[] PROGMEM = "Jul";
+const char monthShortStr8[] PROGMEM = "Aug";
+const char monthShortStr9[] PROGMEM = "Sep";
+const char monthShortStr10[] PROGMEM = "Oct";
+const char monthShortStr11[] PROGMEM = "Nov";
+const char monthShortStr12[] PROGMEM = "Dec";
+
+const PROGMEM char * const PROGMEM monthShortNames_P[] =
+{
+    monthShortStr0,monthShortStr1,monthShortStr2,monthShortStr3,monthShortStr4,monthShortStr5,monthShortStr6,
+    monthShortStr7,monthShortStr8,monthShortStr9,monthShortStr10,monthShortStr11,monthShortStr12
+};
 
 const char dayStr0[] PROGMEM = "Err";
 const char dayStr1[] PROGMEM = "Sunday";
@@ -63,35 +82,250 @@ const PROGMEM char * const PROGMEM dayNames_P[] =
    dayStr0,dayStr1,dayStr2,dayStr3,dayStr4,dayStr5,dayStr6,dayStr7
 };
 
-const char dayShortNames_P[] PROGMEM = "ErrSunMonTueWedThuFriSat";
+const char dayShortStr1[] PROGMEM = "Sun";
+const char dayShortStr2[] PROGMEM = "Mon";
+const char dayShortStr3[] PROGMEM = "Tue";
+const char dayShortStr4[] PROGMEM = "Wed";
+const char dayShortStr5[] PROGMEM = "Thu";
+const char dayShortStr6[] PROGMEM = "Fri";
+const char dayShortStr7[] PROGMEM = "Sat";
+
+const PROGMEM char * const PROGMEM dayShortNames_P[] =
+{
+   dayStr0,dayShortStr1,dayShortStr2,dayShortStr3,dayShortStr4,dayShortStr5,dayShortStr6,dayShortStr7
+};
+
+const dateLocale_t DATE_LOCALE_ENGLISH = { monthNames_P, monthShortNames_P, dayNames_P, dayShortNames_P };
+
+static const dateLocale_t* locale = &DATE_LOCALE_ENGLISH;
+
+/* names as views into the locale */
+
+static dateName_t nameAt(const char* const* names, uint8_t index, uint8_t count)
+{
+    dateName_t name;
+    name.text = (PGM_P)pgm_read_ptr(&names[index < count ? index : 0]);
+    name.length = (uint8_t)strlen_P(name.text);
+    return name;
+}
+
+dateName_t TimeClass::monthName(uint8_t month)
+{
+    return nameAt(locale->months, month, 13);
+}
+
+dateName_t TimeClass::monthShortName(uint8_t month)
+{
+    return nameAt(locale->monthsShort, month, 13);
+}
+
+dateName_t TimeClass::dayName(uint8_t day)
+{
+    return nameAt(locale->days, day, 8);
+}
+
+dateName_t TimeClass::dayShortName(uint8_t day)
+{
+    return nameAt(locale->daysShort, day, 8);
+}
 
 /* functions to return date strings */
 
-char* monthStr(uint8_t month)
+#if defined(__AVR__)
+static char buffer[dt_MAX_STRING_LEN+1];  // names in flash are copied here, longer ones are cut
+
+static const char* terminated(dateName_t name)
 {
-    strcpy_P(buffer, (PGM_P)pgm_read_ptr(&(monthNames_P[month])));
+    uint8_t length = name.length < dt_MAX_STRING_LEN ? name.length : dt_MAX_STRING_LEN;
+    memcpy_P(buffer, name.text, length);
+    buffer[length] = 0;
     return buffer;
 }
+#else
+static inline const char* terminated(dateName_t name)
+{
+    return name.text;  // the tables are in ordinary memory, so the name can be returned as it is
+}
+#endif
+
+const char* TimeClass::monthStr(uint8_t month)
+{
+    return terminated(monthName(month));
+}
+
+const char* TimeClass::monthShortStr(uint8_t month)
+{
+    return terminated(monthShortName(month));
+}
+
+const char* TimeClass::dayStr(uint8_t day)
+{
+    return terminated(dayName(day));
+}
+
+const char* TimeClass::dayShortStr(uint8_t day)
+{
+    return terminated(dayShortName(day));
+}
+
+/* reverse lookup */
+
+#define NAME_BUCKETS 16
+#define NAME_SLOTS   64   // at most 2 * (12 + 7) names, so the table is never more than 60% full
+#define DAY_VALUE    0x80 // slots hold the month, or the day with this bit set; 0 is empty
+
+// the table of the current locale, as buildHash() makes it for English
+static bool hashValid = true;  // false if no perfect hash was found, names are then searched
+static uint8_t displacement[NAME_BUCKETS] = { 0, 0, 0, 5, 3, 2, 0, 0, 1, 0, 0, 3, 0, 1, 0, 2 };
+static uint8_t slots[NAME_SLOTS] = {
+    0x00, 0x87, 0x02, 0x86, 0x0a, 0x00, 0x0a, 0x00, 0x06, 0x07, 0x00, 0x0b, 0x00, 0x81, 0x85, 0x03,
+    0x00, 0x83, 0x00, 0x00, 0x06, 0x00, 0x00, 0x0c, 0x05, 0x00, 0x0c, 0x85, 0x00, 0x84, 0x00, 0x00,
+    0x01, 0x07, 0x09, 0x00, 0x82, 0x04, 0x09, 0x00, 0x00, 0x0b, 0x83, 0x86, 0x08, 0x87, 0x00, 0x00,
+    0x00, 0x03, 0x00, 0x82, 0x00, 0x00, 0x81, 0x08, 0x00, 0x00, 0x01, 0x84, 0x00, 0x00, 0x02, 0x04
+};
+
+static inline uint8_t foldCase(uint8_t c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// FNV-1a of the case folded name, the low bits pick the bucket
+static uint32_t hashName(const char* text, size_t length, bool inFlash)
+{
+    uint32_t h = 2166136261UL;
+    for (size_t i = 0; i < length; i++) {
+        h ^= foldCase(inFlash ? pgm_read_byte(&text[i]) : (uint8_t)text[i]);
+        h *= 16777619UL;
+    }
+    return h;
+}
+
+static inline uint8_t slotOf(uint32_t h, uint8_t d)
+{
+    return (uint8_t)(((h >> 4) + d * ((h >> 16) | 1)) & (NAME_SLOTS - 1));
+}
+
+static bool sameName(const char* text, size_t length, PGM_P name)
+{
+    for (size_t i = 0; i < length; i++) {
+        uint8_t c = pgm_read_byte(&name[i]);
+        if (c == 0 || foldCase(c) != foldCase((uint8_t)text[i])) {
+            return false;
+        }
+    }
+    return pgm_read_byte(&name[length]) == 0;
+}
+
+// true if text is the full or short name of the month or day in value
+static bool matches(const char* text, size_t length, uint8_t value)
+{
+    const char* const* full = (value & DAY_VALUE) ? locale->days : locale->months;
+    const char* const* brief = (value & DAY_VALUE) ? locale->daysShort : locale->monthsShort;
+    uint8_t index = value & ~DAY_VALUE;
+    return sameName(text, length, (PGM_P)pgm_read_ptr(&full[index])) ||
+           sameName(text, length, (PGM_P)pgm_read_ptr(&brief[index]));
+}
+
+static bool buildHash()
+{
+    uint32_t hashes[2 * (12 + 7)];
+    uint8_t values[2 * (12 + 7)];
+    uint8_t count = 0;
+    for (uint8_t i = 1; i <= 12 + 7; i++) {
+        uint8_t value = i <= 12 ? i : (DAY_VALUE | (i - 12));
+        const char* const* full = i <= 12 ? locale->months : locale->days;
+        const char* const* brief = i <= 12 ? locale->monthsShort : locale->daysShort;
+        for (uint8_t j = 0; j < 2; j++) {
+            PGM_P name = (PGM_P)pgm_read_ptr(&(j ? brief : full)[value & ~DAY_VALUE]);
+            hashes[count] = hashName(name, strlen_P(name), true);
+            values[count++] = value;
+        }
+    }
+
+    // place the buckets with the most names first, while the table is still empty
+    memset(slots, 0, sizeof(slots));
+    bool placed[NAME_BUCKETS] = { false };
+    for (uint8_t round = 0; round < NAME_BUCKETS; round++) {
+        uint8_t bucket = 0, size = 0;
+        for (uint8_t b = 0; b < NAME_BUCKETS; b++) {
+            uint8_t n = 0;
+            for (uint8_t k = 0; k < count; k++) {
+                n += (hashes[k] & (NAME_BUCKETS - 1)) == b;
+            }
+            if (!placed[b] && (n > size || size == 0)) {
+                bucket = b;
+                size = n;
+            }
+        }
+        placed[bucket] = true;
+
+        uint16_t d = 0;
+        for (; d < 256; d++) {
+            uint8_t trial[NAME_SLOTS];
+            memcpy(trial, slots, sizeof(trial));
+            uint8_t k = 0;
+            for (; k < count; k++) {
+                if ((hashes[k] & (NAME_BUCKETS - 1)) != bucket) {
+                    continue;
+                }
+                uint8_t s = slotOf(hashes[k], (uint8_t)d);
+                if (trial[s] != 0 && trial[s] != values[k]) {
+                    break;  // a different name is there, the same name twice (May) may share
+                }
+                trial[s] = values[k];
+            }
+            if (k == count) {
+                memcpy(slots, trial, sizeof(slots));
+                break;
+            }
+        }
+        if (d == 256) {
+            return false;
+        }
+        displacement[bucket] = (uint8_t)d;
+    }
+    return true;
+}
+
+// the month, or the day with DAY_VALUE set, named by text; 0 if none
+static uint8_t lookup(const char* text, size_t length)
+{
+    if (text == NULL || length == 0) {
+        return 0;
+    }
+    if (hashValid) {
+        uint32_t h = hashName(text, length, false);
+        uint8_t value = slots[slotOf(h, displacement[h & (NAME_BUCKETS - 1)])];
+        return (value != 0 && matches(text, length, value)) ? value : 0;
+    }
+    for (uint8_t i = 1; i <= 12 + 7; i++) {
+        uint8_t value = i <= 12 ? i : (DAY_VALUE | (i - 12));
+        if (matches(text, length, value)) {
+            return value;
+        }
+    }
+    return 0;
+}
+
+uint8_t TimeClass::monthFromName(const char* text, size_t length)
+{
+    uint8_t value = lookup(text, length);
+    return (value & DAY_VALUE) ? 0 : value;
+}
 
-char* monthShortStr(uint8_t month)
+uint8_t TimeClass::dayFromName(const char* text, size_t length)
 {
-   for (int i=0; i < dt_SHORT_STR_LEN; i++)      
-      buffer[i] = pgm_read_byte(&(monthShortNames_P[i+ (month*dt_SHORT_STR_LEN)]));  
-   buffer[dt_SHORT_STR_LEN] = 0;
-   return buffer;
+    uint8_t value = lookup(text, length);
+    return (value & DAY_VALUE) ? (value & ~DAY_VALUE) : 0;
 }
 
-char* dayStr(uint8_t day) 
+void TimeClass::setDateLocale(const dateLocale_t* table)
 {
-   strcpy_P(buffer, (PGM_P)pgm_read_ptr(&(dayNames_P[day])));
-   return buffer;
+    locale = table ? table : &DATE_LOCALE_ENGLISH;
+    hashValid = buildHash();
 }
 
-char* dayShortStr(uint8_t day) 
+const dateLocale_t* TimeClass::dateLocale()
 {
-   uint8_t index = day*dt_SHORT_STR_LEN;
-   for (int i=0; i < dt_SHORT_STR_LEN; i++)      
-      buffer[i] = pgm_read_byte(&(dayShortNames_P[index + i]));  
-   buffer[dt_SHORT_STR_LEN] = 0; 
-   return buffer;
+    return locale;
 }
@@ -0,0 +1,85 @@
+/* DateTime.cpp
+ * A time with its zone offset and elements as a value for use with the Time library
+ *
+ * The elements are computed by the constant time calendar functions of TimeLib.h when the value
+ * is made, so nothing here reads or writes the cache of the time elements or any other state
+ * shared between threads, except now() which reads the clock and the time zone.
+ */
+
+#if ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+
+#include <string.h>
+#include "TimeLib.h"
+
+#ifndef __AVR__
+#include <type_traits>
+static_assert(std::is_trivially_copyable<DateTime>::value, "a DateTime is copied as plain bytes");
+#endif
+
+static_assert(DateTime::fromLocal(2023, 11, 14, 23, 13, 20, 3600).time() == 1700000000, "from local time");
+static_assert(DateTime(1700000000, 3600).hour() == 23 && DateTime(1700000000).weekday() == 3, "elements");
+static_assert(DateTime::fromLocal(2024, 1, 31, 12).addMonths(1).day() == 29, "clamped to the end of February");
+static_assert(DateTime(1700000000, -1800).minute() == 43 && DateTime(1700000000, -1800).day() == 14, "half an hour west");
+static_assert(DateTime(86400, 3600).addDays(-1).time() == 0 && DateTime(0, -1800) - DateTime(60) == -60, "arithmetic");
+
+DateTime DateTime::now()
+{
+    time_t t = TimeClass::now();
+    return DateTime(t, TimeClass::timeZone());
+}
+
+DateTime DateTime::fromLocal(int year, int month, int day, int hour, int minute, int second, const TimeZone& zone)
+{
+    time_t utc = zone.toUtc(calendarToTime(year, month, day, hour, minute, second));
+    return DateTime(utc, zone);
+}
+
+static inline char* putPair(char* p, uint32_t value)
+{
+    p[0] = (char)('0' + value / 10);
+    p[1] = (char)('0' + value % 10);
+    return p + 2;
+}
+
+size_t DateTime::formatTo(char* buf, size_t size) const
+{
+    char text[DATE_TIME_ISO_SIZE];
+    char* p = text;
+    p = putPair(p, yr / 100 % 100);
+    p = putPair(p, yr % 100);
+    *p++ = '-';
+    p = putPair(p, mon);
+    *p++ = '-';
+    p = putPair(p, mday);
+    *p++ = 'T';
+    p = putPair(p, hr);
+    *p++ = ':';
+    p = putPair(p, mins);
+    *p++ = ':';
+    p = putPair(p, secs);
+    if (zoneOffset == 0) {
+        *p++ = 'Z';
+    } else {
+        uint32_t minutes = (uint32_t)(zoneOffset < 0 ? -zoneOffset : zoneOffset) / 60;
+        *p++ = zoneOffset < 0 ? '-' : '+';
+        p = putPair(p, minutes / 60 % 100);
+        *p++ = ':';
+        p = putPair(p, minutes % 60);
+    }
+    size_t length = p - text;
+    if (size != 0) {
+        size_t n = length < size ? length : size - 1;
+        memcpy(buf, text, n);
+        buf[n] = 0;
+    }
+    return length;
+}
+
+size_t DateTime::formatTo(char* buf, size_t size, const TimeFormat& format) const
+{
+    return format.formatTo(buf, size, *this);
+}
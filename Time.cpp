@@ -55,20 +55,151 @@
 #include <WProgram.h> 
 #endif
 
+#include <stddef.h>
 #include "TimeLib.h"
 
 const char* TIME_FORMAT_DEFAULT = "asctime";
 const char* TIME_FORMAT_ISO8601_FULL = "%Y-%m-%dT%H:%M:%S%z";
 
 TimeClass Time;
-static time_t cacheTime;   // the time the cache was updated
 static uint32_t syncInterval = 300;  // time sync will be attempted after this many seconds
 
-void TimeClass::refreshCache(time_t t) {
-  if (t != cacheTime) {
-    TimeClass::breakTime(t, _tm); 
-    cacheTime = t; 
+/*============================================================================*/
+/* A time is split into the time of day, t % 86400, and the day, t / 86400. The time of day and
+   the weekday are computed on every call, which costs less than reading a cache, so hour() and
+   the other time of day functions never compute the calendar. Only the date of the last day
+   asked for is cached.
+
+   The date cache is shared by all threads as a seqlock: a writer makes cacheSeq odd while it
+   stores a new day and its date, and even again when done. A reader copies the cache and uses
+   the copy only if cacheSeq was even and did not change meanwhile, so it never blocks and never
+   mixes the dates of two days. A cacheSeq of 0 means the cache was never filled. */
+
+static uint32_t cacheSeq = 0;
+static uint32_t cacheDay;    // the day the cache was filled for, counted from Jan 1 1970 as breakTime() does
+static int cacheDate[3];     // mday, mon, year of cacheDay
+
+#ifndef __AVR__
+static inline uint32_t seqLoad(uint32_t* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static inline bool seqLock(uint32_t* p, uint32_t seq) {
+  // the release fence keeps the element stores after the odd sequence
+  bool locked = __atomic_compare_exchange_n(p, &seq, seq + 1, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  return locked;
+}
+static inline void seqUnlock(uint32_t* p, uint32_t seq) { __atomic_store_n(p, seq + 2, __ATOMIC_RELEASE); }
+static inline void seqReadDone() { __atomic_thread_fence(__ATOMIC_ACQUIRE); }
+template <typename T> static inline T relaxedLoad(T* p) { return __atomic_load_n(p, __ATOMIC_RELAXED); }
+template <typename T> static inline void relaxedStore(T* p, T v) { __atomic_store_n(p, v, __ATOMIC_RELAXED); }
+#else
+// single core without threads, only an interrupt can run between two accesses
+static inline uint32_t seqLoad(uint32_t* p) { return *(volatile uint32_t*)p; }
+static inline bool seqLock(uint32_t* p, uint32_t seq) {
+  uint8_t oldSREG = SREG;
+  cli();
+  bool locked = (*(volatile uint32_t*)p == seq);
+  if (locked) {
+    *(volatile uint32_t*)p = seq + 1;
+  }
+  SREG = oldSREG;
+  return locked;
+}
+static inline void seqUnlock(uint32_t* p, uint32_t seq) {
+  uint8_t oldSREG = SREG;
+  cli();
+  *(volatile uint32_t*)p = seq + 2;
+  SREG = oldSREG;
+}
+static inline void seqReadDone() { }
+template <typename T> static inline T relaxedLoad(T* p) { return *(volatile T*)p; }
+template <typename T> static inline void relaxedStore(T* p, T v) { *(volatile T*)p = v; }
+#endif
+
+static cacheStats_t cacheStats;
+#ifdef TIME_CACHE_STATS   // define this to count how the cache is updated, counts from several threads may be lost
+#define CACHE_STAT(counter) (cacheStats.counter++)
+#else
+#define CACHE_STAT(counter)
+#endif
+
+static void nextDay(tm &tme);
+
+// the seconds since midnight and the day of a time, truncated to 32 bits as breakTime() does
+static inline uint32_t secondOfDay(time_t t) { return (uint32_t)t % 86400UL; }
+static inline uint32_t dayNumber(time_t t) { return (uint32_t)t / 86400UL; }
+
+// copy a consistent snapshot of the cache, returns false if it is empty or being written
+static bool readCache(uint32_t &day, tm &tme, uint32_t &seq) {
+  seq = seqLoad(&cacheSeq);
+  if (seq == 0 || (seq & 1)) {
+    return false;
   }
+  day = relaxedLoad(&cacheDay);
+  tme.tm_mday = relaxedLoad(&cacheDate[0]);
+  tme.tm_mon = relaxedLoad(&cacheDate[1]);
+  tme.tm_year = relaxedLoad(&cacheDate[2]);
+  seqReadDone();
+  return relaxedLoad(&cacheSeq) == seq;
+}
+
+// store the date of a day in the cache, unless another thread is storing at the same time
+static void writeCache(uint32_t day, const tm &tme, uint32_t seq) {
+  if (!seqLock(&cacheSeq, seq)) {
+    return;
+  }
+  relaxedStore(&cacheDay, day);
+  relaxedStore(&cacheDate[0], (int)tme.tm_mday);
+  relaxedStore(&cacheDate[1], (int)tme.tm_mon);
+  relaxedStore(&cacheDate[2], (int)tme.tm_year);
+  seqUnlock(&cacheSeq, seq);
+}
+
+// fill tm_mday, tm_mon and tm_year for the day, from the cache if it has that day
+static void dateElements(uint32_t day, tm &tme) {
+  uint32_t cached, seq;
+  if (readCache(cached, tme, seq)) {
+    if (day == cached) {
+      CACHE_STAT(hits);
+      return;
+    }
+    // the next day, as when a clock passes midnight, only carries into the month and year
+    if (day == cached + 1) {
+      nextDay(tme);
+      CACHE_STAT(incremental);
+      writeCache(day, tme, seq);
+      return;
+    }
+  } else {
+    seq = seqLoad(&cacheSeq) & ~1UL;
+  }
+  tme.tm_mday = civilDay((long)day);
+  tme.tm_mon = civilMonth((long)day);
+  tme.tm_year = (int)civilYear((long)day) - 1970;
+  CACHE_STAT(full);
+  writeCache(day, tme, seq);
+}
+
+void TimeClass::timeElements(time_t t, tm &tme) {
+  uint32_t second = secondOfDay(t);
+  uint32_t day = dayNumber(t);
+  tme.tm_sec = second % 60;
+  tme.tm_min = second / 60 % 60;
+  tme.tm_hour = second / 3600;
+  tme.tm_wday = (day + 4) % 7 + 1;  // Sunday is day 1
+  dateElements(day, tme);
+}
+
+void TimeClass::refreshCache(time_t t) {
+  tm tme;
+  timeElements(t, tme);
+}
+
+cacheStats_t TimeClass::getCacheStats() {
+  return cacheStats;
+}
+
+void TimeClass::resetCacheStats() {
+  cacheStats = cacheStats_t();
 }
 
 int TimeClass::hour() { // the hour now 
@@ -76,8 +207,7 @@ int TimeClass::hour() { // the hour now
 }
 
 int TimeClass::hour(time_t t) { // the hour for the given time
-  refreshCache(t);
-  return _tm.tm_hour;  
+  return secondOfDay(t) / 3600;
 }
 
 int TimeClass::hourFormat12() { // the hour now in 12 hour format
@@ -85,13 +215,13 @@ int TimeClass::hourFormat12() { // the hour now in 12 hour format
 }
 
 int TimeClass::hourFormat12(time_t t) { // the hour for the given time in 12 hour format
-  refreshCache(t);
-  if(_tm.tm_hour == 0 )
+  int hr = hour(t);
+  if(hr == 0 )
     return 12; // 12 midnight
-  else if(_tm.tm_hour  > 12)
-    return _tm.tm_hour - 12 ;
+  else if(hr  > 12)
+    return hr - 12 ;
   else
-    return _tm.tm_hour;
+    return hr;
 }
 
 uint8_t TimeClass::isAM() { // returns true if time now is AM
@@ -115,8 +245,7 @@ int TimeClass::minute() {
 }
 
 int TimeClass::minute(time_t t) { // the minute for the given time
-  refreshCache(t);
-  return _tm.tm_min;  
+  return secondOfDay(t) / 60 % 60;
 }
 
 int TimeClass::second() {
@@ -124,8 +253,7 @@ int TimeClass::second() {
 }
 
 int TimeClass::second(time_t t) {  // the second for the given time
-  refreshCache(t);
-  return _tm.tm_sec;
+  return (uint32_t)t % 60;
 }
 
 int TimeClass::day(){
@@ -133,8 +261,9 @@ int TimeClass::day(){
 }
 
 int TimeClass::day(time_t t) { // the day for the given time (0-6)
-  refreshCache(t);
-  return _tm.tm_mday;
+  tm tme;
+  dateElements(dayNumber(t), tme);
+  return tme.tm_mday;
 }
 
 int TimeClass::weekday() {   // Sunday is day 1
@@ -142,8 +271,7 @@ int TimeClass::weekday() {   // Sunday is day 1
 }
 
 int TimeClass::weekday(time_t t) {
-  refreshCache(t);
-  return _tm.tm_wday;
+  return (dayNumber(t) + 4) % 7 + 1;  // Jan 1 1970 was a Thursday
 }
    
 int TimeClass::month(){
@@ -151,8 +279,9 @@ int TimeClass::month(){
 }
 
 int TimeClass::month(time_t t) {  // the month for the given time
-  refreshCache(t);
-  return _tm.tm_mon;
+  tm tme;
+  dateElements(dayNumber(t), tme);
+  return tme.tm_mon;
 }
 
 int TimeClass::year() {  // as in Processing, the full four digit year: (2009, 2010 etc) 
@@ -160,8 +289,9 @@ int TimeClass::year() {  // as in Processing, the full four digit year: (2009, 2
 }
 
 int TimeClass::year(time_t t) { // the year for the given time
-  refreshCache(t);
-  return tmYearToCalendar(_tm.tm_year);
+  tm tme;
+  dateElements(dayNumber(t), tme);
+  return tmYearToCalendar(tme.tm_year);
 }
 
 /*============================================================================*/	
@@ -169,19 +299,37 @@ int TimeClass::year(time_t t) { // the year for the given time
 /* These are for interfacing with time services and are not normally needed in a sketch */
 
 // leap year calculator expects year argument as years offset from 1970
-#define LEAP_YEAR(Y)     ( ((1970+(Y))>0) && !((1970+(Y))%4) && ( ((1970+(Y))%100) || !((1970+(Y))%400) ) )
+#define LEAP_YEAR(Y)     (1970 + (Y) > 0 && isLeapYear(1970 + (Y)))  // year 0 is not taken as a leap year, as before
 
 static  const uint8_t monthDays[]={31,28,31,30,31,30,31,31,30,31,30,31}; // API starts months from 1, this array starts from 0
+static  const uint16_t monthDaysBefore[]={0,31,59,90,120,151,181,212,243,273,304,334}; // days before each month in a common year, starts from 0
+
+// number of leap days in the years from 1 AD up to but not including the given full year
+static inline long leapDaysBefore(long year) {
+  year--;
+  return year/4 - year/100 + year/400;
+}
+
+static_assert(calendarToTime(2000, 1, 1) == SECS_YR_2000, "SECS_YR_2000 is not the start of y2k");
+static_assert(timeWeekday(0) == 5, "Jan 1 1970 was a Thursday");
+static_assert(calendarToTime(2106, 2, 7, 6, 28, 15) == 0xFFFFFFFFLL, "the last 32 bit time");
+static_assert(addMonths(makeDate(2023, 1, 31), 1) == makeDate(2023, 2, 28) &&
+              addMonths(makeDate(2024, 1, 31), 1) == makeDate(2024, 2, 29), "clamped to the end of February");
+static_assert(monthsBetween(makeDate(2023, 1, 31), makeDate(2023, 2, 27)) == 0 &&
+              monthsBetween(makeDate(2023, 1, 31), makeDate(2023, 2, 28)) == 1 &&
+              monthsBetween(makeDate(2023, 3, 31), makeDate(2023, 2, 28)) == -1, "whole months as addMonths() counts them");
+static_assert(isoWeek(makeDate(2020, 12, 31)) == 53 && isoWeek(makeDate(2021, 1, 3)) == 53 &&
+              isoWeekYear(makeDate(2021, 1, 3)) == 2020 && isoWeek(makeDate(2021, 1, 4)) == 1, "ISO week 53 of 2020");
  
 void TimeClass::breakTime(time_t timeInput, tm &tme){
 // break the given time_t into time components
 // this is a more compact version of the C library localtime function
 // note that year is offset from 1970 !!!
+// the date is computed in constant time using years that start on March 1st, so the
+// leap day is the last day of the year and each 400 year era has exactly 146097 days
 
-  uint8_t year;
-  uint8_t month, monthLength;
   uint32_t time;
-  unsigned long days;
+  uint32_t era, dayOfEra, yearOfEra, dayOfYear, mp;
 
   time = (uint32_t)timeInput;
   tme.tm_sec = time % 60;
@@ -191,123 +339,579 @@ void TimeClass::breakTime(time_t timeInput, tm &tme){
   tme.tm_hour = time % 24;
   time /= 24; // now it is days
   tme.tm_wday = ((time + 4) % 7) + 1;  // Sunday is day 1 
-  
-  year = 0;  
-  days = 0;
-  while((unsigned)(days += (LEAP_YEAR(year) ? 366 : 365)) <= time) {
-    year++;
-  }
-  tme.tm_year = year; // year is offset from 1970 
-  
-  days -= LEAP_YEAR(year) ? 366 : 365;
-  time -= days; // now it is days in this year, starting at 0
-  
-  days=0;
-  month=0;
-  monthLength=0;
-  for (month=0; month<12; month++) {
-    if (month==1) { // february
-      if (LEAP_YEAR(year)) {
-        monthLength=29;
-      } else {
-        monthLength=28;
-      }
-    } else {
-      monthLength = monthDays[month];
-    }
-    
-    if (time >= monthLength) {
-      time -= monthLength;
-    } else {
-        break;
-    }
-  }
-  tme.tm_mon = month + 1;  // jan is month 1  
-  tme.tm_mday = time + 1;     // day of month
+
+  time += 719468; // now it is days since 1 Mar 0000
+  era = time / 146097;
+  dayOfEra = time - era * 146097;  // [0, 146096]
+  yearOfEra = (dayOfEra - dayOfEra/1460 + dayOfEra/36524 - dayOfEra/146096) / 365;  // [0, 399]
+  dayOfYear = dayOfEra - (365*yearOfEra + yearOfEra/4 - yearOfEra/100);  // [0, 365], Mar 1 is 0
+  mp = (5*dayOfYear + 2) / 153;  // month starting from March as 0
+
+  tme.tm_mday = dayOfYear - (153*mp + 2)/5 + 1;  // day of month
+  tme.tm_mon = mp < 10 ? mp + 3 : mp - 9;        // jan is month 1
+  tme.tm_year = era * 400 + yearOfEra + (mp >= 10) - 1970; // year is offset from 1970
 }
 
 time_t TimeClass::makeTime(const tm &tme){   
 // assemble time elements into time_t 
 // note year argument is offset from 1970 (see macros in time.h to convert to other formats)
 // previous version used full four digit year (or digits since 2000),i.e. 2009 was 2009 or 9
+// out of range elements are normalized as mktime does, e.g. month 13 is January of the next year
+// and day 0 is the last day of the previous month
   
-  int i;
+  long year, month, days;
   uint32_t seconds;
 
-  // seconds from 1970 till 1 jan 00:00:00 of the given year
-  seconds= tme.tm_year*(SECS_PER_DAY * 365);
-  for (i = 0; i < tme.tm_year; i++) {
-    if (LEAP_YEAR(i)) {
-      seconds += SECS_PER_DAY;   // add extra days for leap years
+  // bring the month into the range 0-11, carrying whole years
+  year = tme.tm_year + 1970L;
+  month = tme.tm_mon - 1;
+  if (month < 0 || month > 11) {
+    year += month / 12;
+    month %= 12;
+    if (month < 0) {
+      month += 12;
+      year--;
     }
   }
-  
+
+  // days from 1970 till 1 jan of the given year, including the leap days of the years in between
+  days = (year - 1970) * 365 + leapDaysBefore(year) - leapDaysBefore(1970);
+
   // add days for this year, months start from 1
-  for (i = 1; i < tme.tm_mon; i++) {
-    if ( (i == 2) && LEAP_YEAR(tme.tm_year)) { 
-      seconds += SECS_PER_DAY * 29;
+  days += monthDaysBefore[month];
+  if (month > 1 && LEAP_YEAR(year - 1970)) {
+    days++;
+  }
+  days += tme.tm_mday - 1;
+
+  seconds = days * SECS_PER_DAY;
+  seconds += tme.tm_hour * SECS_PER_HOUR;
+  seconds += tme.tm_min * SECS_PER_MIN;
+  seconds += tme.tm_sec;
+  return (time_t)seconds; 
+}
+// advance the date elements to the next day, carrying into the month and year
+static void nextDay(tm &tme) {
+  uint8_t monthLength = monthDays[tme.tm_mon - 1];
+  if (tme.tm_mon == 2 && LEAP_YEAR(tme.tm_year)) {
+    monthLength++;
+  }
+  if (tme.tm_mday < monthLength) {
+    tme.tm_mday++;
+  } else {
+    tme.tm_mday = 1;
+    if (tme.tm_mon < 12) {
+      tme.tm_mon++;
     } else {
-      seconds += SECS_PER_DAY * monthDays[i-1];  //monthDay array starts from 0
+      tme.tm_mon = 1;
+      tme.tm_year++;
     }
   }
-  seconds+= (tme.tm_mday-1) * SECS_PER_DAY;
-  seconds+= tme.tm_hour * SECS_PER_HOUR;
-  seconds+= tme.tm_min * SECS_PER_MIN;
-  seconds+= tme.tm_sec;
-  return (time_t)seconds; 
 }
+
 /*=====================================================*/	
 /* Low level system time functions  */
 
 static uint32_t sysTime = 0;
-static uint32_t prevMillis = 0;
+static uint64_t prevTicks = 0;    // the tick count at the start of second sysTime
+static uint16_t prevFraction = 0; // and the fraction of a tick, in 1/65536 tick
+static uint32_t tickRate = 1000;  // ticks per second of the tick source
 static uint32_t nextSyncTime = 0;
 static timeStatus_t Status = timeNotSet;
 
 getExternalTime getTimePtr;  // pointer to external sync function
+static getExternalTimeMs getTimeMsPtr;  // pointer to external sync function with milliseconds
+static requestExternalTime requestTimePtr;  // pointer to function that starts an asynchronous sync
+static syncStatus_t syncState = syncIdle;
+static uint64_t syncRequestTicks;        // the tick count when the pending request was made
+static uint32_t syncTimeout = 1500;      // milliseconds to wait for syncComplete()
+static uint32_t syncFailureCount = 0;    // consecutive failed or timed out asynchronous syncs
+static struct {
+  getTimeSample get;
+  uint8_t priority;     // the weight of its vote
+  uint32_t quality;     // milliseconds added to the uncertainty of its samples
+} syncSources[TIME_SYNC_SOURCES];
+static uint8_t syncSourceCount = 0;
+static uint8_t syncSourcesAgreed = 0;    // the sources that agreed with the time chosen at the last sync
 //setExternalTime setTimePtr; // not used in this version
 
 #ifdef TIME_DRIFT_INFO   // define this to get drift data
 time_t sysUnsyncedTime = 0; // the time sysTime unadjusted by sync  
 #endif
 
+// clock discipline, the length of a second is corrected for the drift of the tick source measured by the syncs
+#define MAX_DRIFT_PPB  500000L  // tick sources that are off by more than 500 ppm are not corrected
+#define MAX_SLEW_PPM   500      // a second is stretched or shortened by at most this much while slewing
+#define MIN_DRIFT_INTERVAL 16   // seconds between syncs needed to measure the drift
+static uint64_t secondLength = 1000UL << 16;  // ticks per second in 1/65536 tick, corrected for drift
+static long driftPpb = 0;             // the tick source is this many parts per billion fast
+static uint8_t driftSamples = 0;      // number of drift measurements, the first one is taken as is
+static long syncOffset = 0;           // milliseconds the clock was behind the sync source at the last sync
+static uint32_t stepThreshold = 128;  // larger offsets are stepped, smaller ones are slewed
+static int32_t slewStep = 0;          // 1/65536 ticks taken off each second while slewing
+static uint32_t slewSeconds = 0;      // seconds left to slew
+static bool haveReference = false;    // whether referenceTime is the time of a sync
+static uint32_t referenceTime;        // sysTime at the last sync, to measure the drift since
+static uint32_t stepTotal = 0;        // the sum of all steps of sysTime, see steppedSeconds()
+static uint32_t baseUncertainty = 0;  // milliseconds the clock may have been off at uncertaintyTime
+static uint32_t uncertaintyTime = 0;  // sysTime at the last sync, or when the time was set or restored
 
-time_t TimeClass::now() {
-	// calculate number of seconds passed since last call to now()
-  while (millis() - prevMillis >= 1000) {
-		// millis() and prevMillis are both unsigned ints thus the subtraction will always be the absolute value of the difference
-    sysTime++;
-    prevMillis += 1000;	
+// warm start, the clock state is saved every snapshotInterval seconds, see setSnapshotStorage()
+#define NO_SNAPSHOT 0xFFFFFFFFUL
+static saveTimeSnapshot saveSnapshotPtr = 0;
+static loadTimeSnapshot loadSnapshotPtr = 0;
+static uint32_t snapshotInterval = 0;
+static uint32_t nextSnapshotTime = NO_SNAPSHOT;
+
+static timeStats_t clockStats;
+static timeTraceHandler traceHandler = 0;
+#ifdef TIME_STATS   // define this to count what the clock does, counts from several threads may be lost
+#define CLOCK_STAT(statement) statement
+
+// the histogram bucket of a number of milliseconds: 0 below 1, then one bucket for each power of 2
+static uint8_t statBucket(uint64_t ms) {
+  uint8_t bucket = 0;
+  while (ms != 0 && bucket < TIME_STATS_BUCKETS - 1) {
+    ms >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+static void trace(timeTraceEvent_t event, long value) {
+  if (traceHandler != 0) {
+    traceHandler(event, value);
+  }
+}
+
+static void recordUpdate(uint32_t secs) {
+  clockStats.nowCalls++;
+  if (secs > 1) {
+    clockStats.catchUps++;
+    clockStats.catchUpSeconds += secs;
+    if (secs > clockStats.catchUpMax) {
+      clockStats.catchUpMax = secs;
+    }
+  }
+}
+
+static void recordSync(uint32_t us, bool ok) {
+  clockStats.syncs++;
+  if (!ok) {
+    clockStats.syncFailures++;
+  }
+  clockStats.syncLatency[statBucket(us / 1000)]++;
+  if (us > clockStats.syncLatencyMaxUs) {
+    clockStats.syncLatencyMaxUs = us;
+  }
+  trace(ok ? timeTraceSync : timeTraceSyncFailed, (long)us);
+}
+
+static void recordStep(int64_t ms) {
+  if (ms == 0) {
+    return;  // set to the time it already was
+  }
+  clockStats.steps++;
+  clockStats.stepSize[statBucket(ms < 0 ? -ms : ms)]++;
+  clockStats.lastStepMs = ms < INT32_MIN ? INT32_MIN : (ms > INT32_MAX ? INT32_MAX : (int32_t)ms);
+  trace(timeTraceStep, (long)clockStats.lastStepMs);
+}
+
+static void recordSlew(int64_t ms) {
+  clockStats.slews++;
+  trace(timeTraceSlew, (long)ms);
+}
+
+static void recordStatus(uint32_t us) {
+  clockStats.statusCalls++;
+  clockStats.statusMicros += us;
+  if (us > clockStats.statusMaxMicros) {
+    clockStats.statusMaxMicros = us;
+  }
+}
+#else
+#define CLOCK_STAT(statement)
+#endif
+
+// millis() extended to 64 bits, this counts the wraps of millis() as long as now() is called at least every 49.7 days
+static uint64_t millisTicks() {
+  static uint32_t wraps = 0;
+  static uint32_t lastMillis = 0;
+  uint32_t ms = millis();
+  if (ms < lastMillis) {
+    wraps++;
+  }
+  lastMillis = ms;
+  return ((uint64_t)wraps << 32) | ms;
+}
+
+static getTickCount tickSource = millisTicks;
+
+static inline uint32_t msToTicks(uint32_t ms) {
+  return tickRate == 1000 ? ms : (uint32_t)((uint64_t)ms * tickRate / 1000);
+}
+
+#ifdef TIME_STATS
+static inline uint32_t ticksToUs(uint64_t ticks) {
+  return (uint32_t)(ticks * 1000000 / tickRate);
+}
+#endif
+
+// the length of the current second, shorter or longer while slewing
+static inline uint64_t currentSecondLength() {
+  return slewSeconds != 0 ? secondLength - slewStep : secondLength;
+}
+
+// the milliseconds of the current second, given the 1/65536 ticks elapsed in it
+static inline uint32_t elapsedToMs(uint64_t elapsed) {
+  return (uint32_t)(elapsed * 1000 / currentSecondLength());
+}
+
+// set the length of a second for a tick source that is driftPpb fast
+static void setDrift(long ppb) {
+  driftPpb = ppb;
+  // tickRate * 65536 * ppb / 10^9, with 65536 / 10^9 reduced to 128 / 1953125 to stay in 64 bits
+  secondLength = ((uint64_t)tickRate << 16) + (int64_t)tickRate * ppb * 128 / 1953125;
+}
+
+// stop slewing and forget the last sync, the clock was set by hand
+static void resetDiscipline() {
+  slewSeconds = 0;
+  haveReference = false;
+}
+
+// the clock is known to within ms milliseconds now
+static void setUncertainty(uint64_t ms) {
+  baseUncertainty = ms > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)ms;
+  uncertaintyTime = sysTime;
+}
+
+// the most the corrected clock may wander in the given seconds
+static inline uint64_t driftBoundMs(uint32_t secs) {
+  return (uint64_t)secs * TIME_DRIFT_BOUND_PPM / 1000;
+}
+
+// seconds since uncertaintyTime, 0 if the clock was adjusted back past it
+static inline uint32_t uncertaintyAge() {
+  return (int32_t)(sysTime - uncertaintyTime) > 0 ? sysTime - uncertaintyTime : 0;
+}
+
+static uint64_t advanceToTicks(uint64_t ticks);
+
+// set the clock to the given second, with ms milliseconds of it already elapsed
+static void setClock(uint32_t secs, uint32_t ms) {
 #ifdef TIME_DRIFT_INFO
-    sysUnsyncedTime++; // this can be compared to the synced time to measure long term drift     
+ if(sysUnsyncedTime == 0) 
+   sysUnsyncedTime = secs;   // store the time of the first call to set a valid Time   
 #endif
+
+  if (Status != timeNotSet) {
+    // count up to now first, so the seconds since now() was last called are not taken for a step
+    uint64_t elapsed = advanceToTicks(tickSource());
+    (void)elapsed;
+    CLOCK_STAT(recordStep((int64_t)secs * 1000 + ms - ((int64_t)sysTime * 1000 + elapsedToMs(elapsed))));
   }
-  if (nextSyncTime <= sysTime) {
-    if (getTimePtr != 0) {
-      time_t t = getTimePtr();
-      if (t != 0) {
-        setTime(t);
-      } else {
-        nextSyncTime = sysTime + syncInterval;
-        Status = (Status == timeNotSet) ?  timeNotSet : timeNeedsSync;
+  stepTotal += secs - sysTime;
+  sysTime = secs;
+  nextSyncTime = secs + syncInterval;
+  if (nextSnapshotTime != NO_SNAPSHOT) {
+    nextSnapshotTime = secs;  // save the new time at the next update
+  }
+  Status = timeSet;
+  prevTicks = tickSource() - msToTicks(ms);  // restart counting from now (thanks to Korman for this fix)
+  prevFraction = 0;
+}
+
+// a sync source says the time is between lo and hi milliseconds, elapsed is the part of the current second counted
+// the drift of the tick source is estimated from the offsets of successive syncs, small offsets are slewed away
+static void disciplineClock(time_ms_t lo, time_ms_t hi, uint64_t elapsed) {
+  if (Status == timeNotSet) {
+    setClock((uint32_t)(lo / 1000), (uint32_t)(lo % 1000));
+    syncOffset = 0;
+    slewSeconds = 0;
+    haveReference = true;
+    referenceTime = sysTime;
+    setUncertainty(hi - lo);
+    return;
+  }
+  time_ms_t local = (time_ms_t)sysTime * 1000 + elapsedToMs(elapsed);
+  time_ms_t target = local < lo ? lo : (local > hi ? hi : local);
+  time_ms_t offset = target - local;
+
+  if (offset == 0 && haveReference) {
+    syncOffset = 0;
+    nextSyncTime = sysTime + syncInterval;
+    Status = timeSet;
+    setUncertainty(hi - lo);
+    return;  // nothing learned, keep measuring the drift from the last correction
+  }
+  if (haveReference && sysTime - referenceTime >= MIN_DRIFT_INTERVAL) {
+    // the part of the previous offset that is not slewed yet is not drift
+    int64_t unslewed = (int64_t)slewStep * slewSeconds * 1000 / (int64_t)secondLength;
+    int64_t sample = (offset - unslewed) * 1000000 / (int64_t)(sysTime - referenceTime);
+    if (sample >= -MAX_DRIFT_PPB && sample <= MAX_DRIFT_PPB) {  // otherwise the source has jumped
+      long ppb = driftPpb - (long)(driftSamples == 0 ? sample : sample / 4);
+      setDrift(ppb < -MAX_DRIFT_PPB ? -MAX_DRIFT_PPB : (ppb > MAX_DRIFT_PPB ? MAX_DRIFT_PPB : ppb));
+      if (driftSamples < 255) {
+        driftSamples++;
       }
     }
-  }  
-  return (time_t)sysTime;
+  }
+  syncOffset = (long)offset;
+
+  if (offset > (time_ms_t)stepThreshold || offset < -(time_ms_t)stepThreshold) {
+    setClock((uint32_t)(target / 1000), (uint32_t)(target % 1000));
+    slewSeconds = 0;
+  } else {
+    // at most MAX_SLEW_PPM of each second, spread evenly over the seconds needed
+    int64_t slew = offset * (int64_t)tickRate * 65536 / 1000;
+    int64_t maxStep = ((int64_t)tickRate << 16) / (1000000 / MAX_SLEW_PPM);
+    int64_t magnitude = slew < 0 ? -slew : slew;
+    slewSeconds = (uint32_t)((magnitude + maxStep - 1) / maxStep);
+    slewStep = slewSeconds != 0 ? (int32_t)(slew / slewSeconds) : 0;
+    nextSyncTime = sysTime + syncInterval;
+    Status = timeSet;
+    CLOCK_STAT(recordSlew(offset));
+  }
+  haveReference = true;
+  referenceTime = sysTime;
+  setUncertainty(hi - lo + (slewSeconds != 0 ? (offset < 0 ? -offset : offset) : 0));  // until the offset is slewed away
 }
 
-void TimeClass::setTime(time_t t) { 
+// an asynchronous sync failed or timed out, retry after 1, 2, 4 ... seconds up to the sync interval
+static void asyncSyncFailed() {
+  CLOCK_STAT(recordSync(ticksToUs(tickSource() - syncRequestTicks), false));
+  uint32_t retry = syncInterval;
+  syncFailureCount++;
+  if (syncFailureCount <= 32 && (1UL << (syncFailureCount - 1)) < retry) {
+    retry = 1UL << (syncFailureCount - 1);
+  }
+  nextSyncTime = sysTime + retry;
+  syncState = syncBackoff;
+  Status = (Status == timeSet) ? timeNeedsSync : Status;  // a clock that is not set or estimated stays so
+}
+
+// the milliseconds since Jan 1 1970 of the clock, without syncing
+static time_ms_t localMs(uint64_t& elapsed) {
+  elapsed = advanceToTicks(tickSource());
+  return (time_ms_t)sysTime * 1000 + elapsedToMs(elapsed);
+}
+
+// ask every source and keep the offset range that the largest weight of sources agrees on (Marzullo's algorithm)
+// each answer says the clock is off by between lo and hi milliseconds: the source's time when it answered reached
+// us after up to the round trip, and it may itself be off by its uncertainty and the quality of the source
+struct syncEdge {
+  int64_t offset;   // milliseconds the clock is behind
+  int8_t start;     // 1 where the interval of the source starts, -1 where it ends
+  uint8_t source;
+};
+
+static bool syncWithSources() {
+  syncEdge edges[2 * TIME_SYNC_SOURCES];
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < syncSourceCount; i++) {
+    timeSample_t sample = { 0, 0, 0 };
+    if (!syncSources[i].get(sample) || sample.time == 0) {
+      continue;
+    }
+    uint64_t elapsed;
+    time_ms_t local = localMs(elapsed);
+    int64_t error = (int64_t)sample.uncertainty + syncSources[i].quality;
+    edges[count].offset = sample.time - error - local;
+    edges[count].start = 1;
+    edges[count++].source = i;
+    edges[count].offset = sample.time + sample.roundTrip + error - local;
+    edges[count].start = -1;
+    edges[count++].source = i;
+  }
+  if (count == 0) {
+    return false;
+  }
+
+  // by offset, with the starts first so intervals that only touch still intersect
+  for (uint8_t i = 1; i < count; i++) {
+    for (uint8_t j = i; j > 0 && (edges[j].offset < edges[j - 1].offset ||
+         (edges[j].offset == edges[j - 1].offset && edges[j].start > edges[j - 1].start)); j--) {
+      syncEdge edge = edges[j];
+      edges[j] = edges[j - 1];
+      edges[j - 1] = edge;
+    }
+  }
+  int weight = 0, bestWeight = 0;
+  uint8_t members = 0, bestMembers = 0;
+  int64_t lo = 0, hi = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    weight += edges[i].start * syncSources[edges[i].source].priority;
+    members ^= 1 << edges[i].source;
+    if (edges[i].start > 0 && i + 1 < count) {
+      // the range up to the next edge is inside the current intervals; equal weights keep the narrower range
+      int64_t width = edges[i + 1].offset - edges[i].offset;
+      if (weight > bestWeight || (weight == bestWeight && width < hi - lo)) {
+        bestWeight = weight;
+        bestMembers = members;
+        lo = edges[i].offset;
+        hi = edges[i + 1].offset;
+      }
+    }
+  }
+  syncSourcesAgreed = bestMembers;
+
+  uint64_t elapsed;
+  time_ms_t local = localMs(elapsed);
+  disciplineClock(local + lo, local + hi, elapsed);
+  return true;
+}
+
+// sync with the provider that is due, returns true if the clock was set
+static bool syncClock(uint64_t ticks, uint64_t elapsed) {
+  if (requestTimePtr != 0) {
+    // never blocks: start a request, or give up on one that took too long
+    if (syncState != syncPending) {
+      syncState = syncPending;
+      syncRequestTicks = ticks;
+      requestTimePtr();  // may call syncComplete() straight away
+      return syncState == syncIdle;
+    }
+    if (ticks - syncRequestTicks >= msToTicks(syncTimeout)) {
+      asyncSyncFailed();
+    }
+    return false;
+  }
+  CLOCK_STAT(uint32_t start = micros());
+  if (syncSourceCount != 0) {
+    bool ok = syncWithSources();
+    CLOCK_STAT(recordSync(micros() - start, ok));
+    if (ok) {
+      return true;
+    }
+  } else if (getTimeMsPtr != 0) {
+    time_ms_t t = getTimeMsPtr();
+    CLOCK_STAT(recordSync(micros() - start, t != 0));
+    if (t != 0) {
+      disciplineClock(t, t, elapsed);
+      return true;
+    }
+  } else if (getTimePtr != 0) {
+    time_t t = getTimePtr();
+    CLOCK_STAT(recordSync(micros() - start, t != 0));
+    if (t != 0) {
+      disciplineClock((time_ms_t)t * 1000, (time_ms_t)t * 1000 + 999, elapsed);  // anywhere in second t
+      return true;
+    }
+  } else {
+    return false;
+  }
+  nextSyncTime = sysTime + syncInterval;
+  Status = (Status == timeSet) ? timeNeedsSync : Status;  // a clock that is not set or estimated stays so
+  return false;
+}
+
+// count whole seconds of the given length
+static void advanceClock(uint32_t secs, uint64_t length) {
+  uint64_t total = prevFraction + (uint64_t)secs * length;
+  prevTicks += total >> 16;
+  prevFraction = (uint16_t)total;
+  sysTime += secs;
 #ifdef TIME_DRIFT_INFO
- if(sysUnsyncedTime == 0) 
-   sysUnsyncedTime = t;   // store the time of the first call to set a valid Time   
+  sysUnsyncedTime += secs; // this can be compared to the synced time to measure long term drift     
 #endif
+}
 
-  sysTime = (uint32_t)t;  
-  nextSyncTime = (uint32_t)t + syncInterval;
-  Status = timeSet;
-  prevMillis = millis();  // restart counting from now (thanks to Korman for this fix)
+// advance sysTime to the given tick count, returns the 1/65536 ticks elapsed in the current second
+static uint64_t advanceToTicks(uint64_t ticks) {
+  // calculate number of seconds passed since last call to now(), a division takes the same time however long ago that was
+  // the tick count and prevTicks are both unsigned thus the subtraction will always be the absolute value of the difference
+  uint64_t elapsed = ((ticks - prevTicks) << 16) - prevFraction;
+  if (slewSeconds != 0) {
+    uint64_t length = secondLength - slewStep;
+    if (elapsed >= length) {
+      uint32_t secs = (elapsed < 2 * length) ? 1 : (uint32_t)(elapsed / length);
+      if (secs > slewSeconds) {
+        secs = slewSeconds;
+      }
+      advanceClock(secs, length);
+      elapsed -= (uint64_t)secs * length;
+      slewSeconds -= secs;
+    }
+  }
+  if (slewSeconds == 0 && elapsed >= secondLength) {
+    uint32_t secs = (elapsed < 2 * secondLength) ? 1 : (uint32_t)(elapsed / secondLength);
+    advanceClock(secs, secondLength);
+    elapsed -= (uint64_t)secs * secondLength;
+  }
+  return elapsed;
+}
+
+// FNV-1a of the snapshot up to its check
+static uint32_t snapshotCheck(const timeSnapshot_t& snapshot) {
+  const uint8_t* bytes = (const uint8_t*)&snapshot;
+  uint32_t hash = 2166136261UL;
+  for (size_t i = 0; i < offsetof(timeSnapshot_t, check); i++) {
+    hash = (hash ^ bytes[i]) * 16777619UL;
+  }
+  return hash;
+}
+
+static void scheduleSnapshot() {
+  nextSnapshotTime = (saveSnapshotPtr != 0 && snapshotInterval != 0) ? sysTime + snapshotInterval : NO_SNAPSHOT;
+}
+
+// save the clock state, elapsed is the part of the current second counted
+static bool takeSnapshot(uint64_t elapsed) {
+  scheduleSnapshot();
+  if (Status == timeNotSet || saveSnapshotPtr == 0) {
+    return false;
+  }
+  timeSnapshot_t snapshot = timeSnapshot_t();
+  snapshot.version = TIME_SNAPSHOT_VERSION;
+  snapshot.uncertaintyMs = baseUncertainty;
+  snapshot.time = (time_ms_t)sysTime * 1000 + elapsedToMs(elapsed);
+  snapshot.syncAge = uncertaintyAge();
+  snapshot.driftPpb = (int32_t)driftPpb;
+  snapshot.driftSamples = driftSamples;
+  snapshot.status = (uint8_t)Status;
+  snapshot.check = snapshotCheck(snapshot);
+  return saveSnapshotPtr(snapshot);
+}
+
+// advance sysTime to the current second and sync if due, returns the 1/65536 ticks elapsed in the current second
+static uint64_t updateClock() {
+  uint64_t ticks = tickSource();
+  CLOCK_STAT(uint32_t before = sysTime);
+  uint64_t elapsed = advanceToTicks(ticks);
+  CLOCK_STAT(recordUpdate(sysTime - before));
+  if (nextSyncTime <= sysTime) {
+    syncClock(ticks, elapsed);
+    elapsed = advanceToTicks(tickSource());  // the clock may have been set, or asking the sources took a while
+  }
+  if (nextSnapshotTime <= sysTime) {
+    takeSnapshot(elapsed);
+  }
+  return elapsed;
+}
+
+time_t TimeClass::now() {
+  updateClock();
+  return (time_t)sysTime;
+}
+
+time_ms_t TimeClass::nowMs() {
+  uint32_t ms = elapsedToMs(updateClock());
+  return (time_ms_t)sysTime * 1000 + ms;
+}
+
+void TimeClass::setTime(time_t t) { 
+  setClock((uint32_t)t, 0);
+  resetDiscipline();
+  setUncertainty(1000);  // anywhere in second t
 } 
 
+void TimeClass::setTimeMs(time_ms_t t) {
+  setClock((uint32_t)(t / 1000), (uint32_t)(t % 1000));
+  resetDiscipline();
+  setUncertainty(0);
+}
+
 void TimeClass::setTime(int hr,int min,int sec,int dy, int mnth, int yr){
  // year can be given as full four digit year or two digts (2010 or 10 for 2010);  
  //it is converted to years since 1970
@@ -316,109 +920,567 @@ void TimeClass::setTime(int hr,int min,int sec,int dy, int mnth, int yr){
   else
       yr += 30;
 
-  _tm.tm_year = yr;
-  _tm.tm_mon = mnth;
-  _tm.tm_mday = dy;
-  _tm.tm_hour = hr;
-  _tm.tm_min = min;
-  _tm.tm_sec = sec;
-  setTime(makeTime(_tm));
+  tm tme = {};
+  tme.tm_year = yr;
+  tme.tm_mon = mnth;
+  tme.tm_mday = dy;
+  tme.tm_hour = hr;
+  tme.tm_min = min;
+  tme.tm_sec = sec;
+  setTime(makeTime(tme));
 }
 
 void TimeClass::adjustTime(long adjustment) {
+  CLOCK_STAT(recordStep((int64_t)adjustment * 1000));
   sysTime += adjustment;
+  stepTotal += adjustment;
+  uncertaintyTime += adjustment;  // the age of the uncertainty counts only the time that passed
+  resetDiscipline();
+  if (nextSnapshotTime != NO_SNAPSHOT) {
+    nextSnapshotTime = sysTime;  // save the new time at the next update, as setClock() does
+  }
+}
+
+void TimeClass::adjustTimeMs(long adjustment) {
+  CLOCK_STAT(recordStep(adjustment));
+  long ms = adjustment % 1000;
+  if (ms < 0) {
+    ms += 1000;
+  }
+  sysTime += (adjustment - ms) / 1000;
+  stepTotal += (adjustment - ms) / 1000;
+  uncertaintyTime += (adjustment - ms) / 1000;
+  prevTicks -= msToTicks(ms);  // the extra milliseconds are carried into sysTime by the next now()
+  resetDiscipline();
+  if (nextSnapshotTime != NO_SNAPSHOT) {
+    nextSnapshotTime = sysTime;
+  }
+}
+
+void TimeClass::setTickSource(getTickCount ticksFunction, uint32_t ticksPerSecond) {
+  uint32_t ms = elapsedToMs(updateClock());  // keep the fraction of the current second
+  if (ticksFunction != 0 && ticksPerSecond != 0) {
+    tickSource = ticksFunction;
+    tickRate = ticksPerSecond;
+  } else {
+    tickSource = millisTicks;
+    tickRate = 1000;
+  }
+  prevTicks = tickSource() - msToTicks(ms);
+  prevFraction = 0;
+  resetDiscipline();
+  driftSamples = 0;  // the drift of the old source does not apply to the new one
+  setDrift(0);
+}
+
+void TimeClass::setStepThreshold(uint32_t ms) {
+  stepThreshold = ms;
+}
+
+long TimeClass::clockDriftPpb() {
+  return driftPpb;
+}
+
+long TimeClass::clockOffsetMs() {
+  return syncOffset;
+}
+
+uint32_t TimeClass::steppedSeconds() {
+  return stepTotal;
+}
+
+void TimeClass::setSnapshotStorage(saveTimeSnapshot save, loadTimeSnapshot load, uint32_t intervalSeconds) {
+  saveSnapshotPtr = save;
+  loadSnapshotPtr = load;
+  snapshotInterval = intervalSeconds;
+  scheduleSnapshot();
+}
+
+bool TimeClass::restoreSnapshot(uint32_t offSeconds, uint32_t offUncertaintyMs) {
+  timeSnapshot_t snapshot;
+  if (Status != timeNotSet || loadSnapshotPtr == 0 || !loadSnapshotPtr(snapshot)) {
+    return false;
+  }
+  if (snapshot.version != TIME_SNAPSHOT_VERSION || snapshot.check != snapshotCheck(snapshot) ||
+      snapshot.time <= 0 || snapshot.status == timeNotSet || snapshot.status > timeEstimated) {
+    return false;
+  }
+  // the reset came some time in the save interval after the snapshot, take the middle of it
+  uint32_t half = snapshotInterval / 2;
+  time_ms_t t = snapshot.time + ((time_ms_t)offSeconds + half) * 1000;
+  setClock((uint32_t)(t / 1000), (uint32_t)(t % 1000));
+  resetDiscipline();
+  Status = timeEstimated;
+  nextSyncTime = sysTime;  // sync as soon as there is a provider
+  scheduleSnapshot();  // not the restored state again
+  long ppb = snapshot.driftPpb;
+  setDrift(ppb < -MAX_DRIFT_PPB ? -MAX_DRIFT_PPB : (ppb > MAX_DRIFT_PPB ? MAX_DRIFT_PPB : ppb));
+  driftSamples = snapshot.driftSamples != 0 ? 1 : 0;  // measured in an earlier run, new samples weigh more
+  setUncertainty(snapshot.uncertaintyMs + driftBoundMs(snapshot.syncAge + snapshotInterval) +
+                 (uint64_t)half * 1000 + offUncertaintyMs);
+  return true;
+}
+
+bool TimeClass::saveSnapshot() {
+  return takeSnapshot(updateClock());
+}
+
+uint32_t TimeClass::timeUncertaintyMs() {
+  now();
+  if (Status == timeNotSet) {
+    return 0xFFFFFFFF;
+  }
+  uint64_t ms = baseUncertainty + driftBoundMs(uncertaintyAge());
+  return ms > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)ms;
 }
 
 // indicates if time has been set and recently synchronized
 timeStatus_t TimeClass::timeStatus() {
+  CLOCK_STAT(uint32_t start = micros());
   now(); // required to actually update the status
+  CLOCK_STAT(recordStatus(micros() - start));
   return Status;
 }
 
+timeStats_t TimeClass::getTimeStats() {
+  timeStats_t stats = clockStats;
+  stats.cache = cacheStats;
+  stats.driftPpb = driftPpb;
+  stats.offsetMs = syncOffset;
+  stats.driftSamples = driftSamples;
+  return stats;
+}
+
+void TimeClass::resetTimeStats() {
+  clockStats = timeStats_t();
+  cacheStats = cacheStats_t();
+}
+
+void TimeClass::setTimeTrace(timeTraceHandler handler) {
+  traceHandler = handler;
+}
+
+// only one kind of provider is used at a time
+static void clearSyncProviders() {
+  getTimePtr = 0;
+  getTimeMsPtr = 0;
+  requestTimePtr = 0;
+  syncSourceCount = 0;
+  syncSourcesAgreed = 0;
+  syncState = syncIdle;
+  syncFailureCount = 0;
+}
+
 void TimeClass::setSyncProvider( getExternalTime getTimeFunction){
+  clearSyncProviders();
   getTimePtr = getTimeFunction;  
   nextSyncTime = sysTime;
   now(); // this will sync the clock
 }
 
+void TimeClass::setSyncProviderMs( getExternalTimeMs getTimeFunction){
+  clearSyncProviders();
+  getTimeMsPtr = getTimeFunction;
+  nextSyncTime = sysTime;
+  now(); // this will sync the clock
+}
+
+void TimeClass::setSyncRequest( requestExternalTime requestFunction, uint32_t timeoutMs){
+  clearSyncProviders();
+  requestTimePtr = requestFunction;
+  syncTimeout = timeoutMs;
+  nextSyncTime = sysTime;
+  now(); // this will request the first sync
+}
+
+bool TimeClass::addSyncSource(getTimeSample source, uint8_t priority, uint32_t qualityMs) {
+  if (source == 0) {
+    return false;
+  }
+  uint8_t i = 0;
+  while (i < syncSourceCount && syncSources[i].get != source) {
+    i++;
+  }
+  if (i == TIME_SYNC_SOURCES) {
+    return false;
+  }
+  if (i == syncSourceCount) {
+    if (syncSourceCount == 0) {
+      clearSyncProviders();  // the sources replace a single provider
+    }
+    syncSourceCount++;
+  }
+  syncSources[i].get = source;
+  syncSources[i].priority = priority != 0 ? priority : 1;
+  syncSources[i].quality = qualityMs;
+  nextSyncTime = sysTime;
+  now(); // this will sync the clock
+  return true;
+}
+
+uint8_t TimeClass::syncSourcesUsed() {
+  return syncSourcesAgreed;
+}
+
+// an answer to the pending request, the time is between lo and hi milliseconds
+static bool completeSync(time_ms_t lo, time_ms_t hi) {
+  uint64_t elapsed = updateClock();
+  if (syncState != syncPending) {
+    return false; // not requested, or too late
+  }
+  if (lo == 0) {
+    asyncSyncFailed();
+    return false;
+  }
+  syncState = syncIdle;
+  syncFailureCount = 0;
+  CLOCK_STAT(recordSync(ticksToUs(tickSource() - syncRequestTicks), true));
+  disciplineClock(lo, hi, elapsed);
+  return true;
+}
+
+bool TimeClass::syncComplete(time_t t) {
+  return completeSync((time_ms_t)t * 1000, (time_ms_t)t * 1000 + 999);  // anywhere in second t
+}
+
+bool TimeClass::syncCompleteMs(time_ms_t t) {
+  return completeSync(t, t);
+}
+
+void TimeClass::syncFailed() {
+  if (syncState == syncPending) {
+    asyncSyncFailed();
+  }
+}
+
+syncStatus_t TimeClass::syncStatus() {
+  now(); // required to notice a timeout
+  return syncState;
+}
+
+uint32_t TimeClass::syncFailures() {
+  return syncFailureCount;
+}
+
 void TimeClass::setSyncInterval(time_t interval){ // set the number of seconds between re-sync
   syncInterval = (uint32_t)interval;
   nextSyncTime = sysTime + syncInterval;
 }
 
-struct tm calendar_time_cache;	// a cache of calendar time structure elements
-time_t unix_time_cache;  		// a cache of unix_time that was updated
-time_t time_zone_cache;			// a cache of the time zone that was set
-time_t dst_cache = 3600;        // a cache of the DST offset that was set (default 1hr)
-time_t dst_current_cache = 0;   // a cache of the DST offset currently being applied
+/*============================================================================*/
+/* time zones compiled from POSIX TZ strings */
+
+// days from 1970 till 1 jan of the given full year
+static long daysBeforeYear(long year) {
+  return (year - 1970) * 365 + leapDaysBefore(year) - leapDaysBefore(1970);
+}
+
+// a zone name, three or more letters or anything but '>' between '<' and '>'
+static const char* parseZoneName(const char* p, char* name, size_t size) {
+  size_t len = 0;
+  if (*p == '<') {
+    for (p++; *p && *p != '>'; p++) {
+      if (len + 1 < size) {
+        name[len++] = *p;
+      }
+    }
+    if (*p++ != '>') {
+      return NULL;
+    }
+  } else {
+    for (; (*p >= 'A' && *p <= 'Z') || (*p >= 'a' && *p <= 'z'); p++) {
+      if (len + 1 < size) {
+        name[len++] = *p;
+      }
+    }
+  }
+  name[len] = 0;
+  return len >= 3 ? p : NULL;
+}
+
+// [+|-]hh[:mm[:ss]] in seconds, hours up to maxHours
+static const char* parseZoneTime(const char* p, long& seconds, long maxHours) {
+  long sign = 1;
+  if (*p == '+' || *p == '-') {
+    sign = (*p++ == '-') ? -1 : 1;
+  }
+  long parts[3] = {0, 0, 0};
+  for (int i = 0; i < 3; i++) {
+    if (*p < '0' || *p > '9') {
+      return NULL;
+    }
+    long value = 0;
+    for (int digits = 0; *p >= '0' && *p <= '9' && digits < 3; digits++) {
+      value = value * 10 + (*p++ - '0');
+    }
+    if (value > (i == 0 ? maxHours : 59)) {
+      return NULL;
+    }
+    parts[i] = value;
+    if (*p != ':' || i == 2) {
+      break;
+    }
+    p++;
+  }
+  seconds = sign * (parts[0] * 3600 + parts[1] * 60 + parts[2]);
+  return p;
+}
+
+static const char* parseZoneNumber(const char* p, long& value, long min, long max) {
+  if (*p < '0' || *p > '9') {
+    return NULL;
+  }
+  for (value = 0; *p >= '0' && *p <= '9'; p++) {
+    value = value * 10 + (*p - '0');
+    if (value > max) {
+      return NULL;
+    }
+  }
+  return value >= min ? p : NULL;
+}
+
+TimeZone::TimeZone()
+  : stdOffset(0), dstOffset(0), hasDst(false), seq(0) {
+  strcpy(stdName, "UTC");
+  dstName[0] = 0;
+}
+
+TimeZone::TimeZone(const char* tz)
+  : stdOffset(0), dstOffset(0), hasDst(false), seq(0) {
+  strcpy(stdName, "UTC");
+  dstName[0] = 0;
+  set(tz);
+}
+
+bool TimeZone::set(const char* tz) {
+  TimeZone zone;
+  const char* p = tz;
+  long value;
+  if (p == NULL || (p = parseZoneName(p, zone.stdName, sizeof(zone.stdName))) == NULL ||
+      (p = parseZoneTime(p, value, 24)) == NULL) {
+    return false;
+  }
+  zone.stdOffset = -value;  // POSIX offsets are west of UTC
+  if (*p) {
+    if ((p = parseZoneName(p, zone.dstName, sizeof(zone.dstName))) == NULL) {
+      return false;
+    }
+    zone.hasDst = true;
+    zone.dstOffset = zone.stdOffset + 3600;
+    if (*p && *p != ',') {
+      if ((p = parseZoneTime(p, value, 24)) == NULL) {
+        return false;
+      }
+      zone.dstOffset = -value;
+    }
+    // the US rules are the default, as in glibc
+    const char* rules = *p ? p : ",M3.2.0,M11.1.0";
+    Rule* rule[2] = { &zone.dstStart, &zone.dstEnd };
+    for (int i = 0; i < 2; i++) {
+      Rule& r = *rule[i];
+      if (*rules++ != ',') {
+        return false;
+      }
+      r.month = r.week = r.wday = 0;
+      r.day = 0;
+      if (*rules == 'M') {
+        long month, week, wday;
+        if ((rules = parseZoneNumber(rules + 1, month, 1, 12)) == NULL || *rules++ != '.' ||
+            (rules = parseZoneNumber(rules, week, 1, 5)) == NULL || *rules++ != '.' ||
+            (rules = parseZoneNumber(rules, wday, 0, 6)) == NULL) {
+          return false;
+        }
+        r.kind = 'M';
+        r.month = (uint8_t)month;
+        r.week = (uint8_t)week;
+        r.wday = (uint8_t)wday;
+      } else if (*rules == 'J') {
+        if ((rules = parseZoneNumber(rules + 1, value, 1, 365)) == NULL) {
+          return false;
+        }
+        r.kind = 'J';
+        r.day = (uint16_t)value;
+      } else {
+        if ((rules = parseZoneNumber(rules, value, 0, 365)) == NULL) {
+          return false;
+        }
+        r.kind = 'D';
+        r.day = (uint16_t)value;
+      }
+      r.time = 2 * 3600;
+      if (*rules == '/' && (rules = parseZoneTime(rules + 1, r.time, 167)) == NULL) {
+        return false;
+      }
+    }
+    if (*rules) {
+      return false;
+    }
+  }
+  // the cache of this zone is emptied by the copy
+  *this = zone;
+  return true;
+}
+
+// the time of a transition in the given full year, the rule time is wall clock time at wallOffset
+// in 64 bits, the transitions of 1970 and 2106 can be outside the 32 bit range
+int64_t TimeZone::transition(const Rule& rule, long year, long wallOffset) const {
+  long days = daysBeforeYear(year);
+  bool leap = LEAP_YEAR(year - 1970);
+  if (rule.kind == 'J') {
+    days += rule.day - 1 + (leap && rule.day >= 60);  // Feb 29 is never counted
+  } else if (rule.kind == 'D') {
+    days += rule.day;
+  } else {
+    long first = days + monthDaysBefore[rule.month - 1] + (leap && rule.month > 2);
+    long length = monthDays[rule.month - 1] + (leap && rule.month == 2);
+    days = first + (rule.wday - (first + 4) % 7 + 7) % 7 + (rule.week - 1) * 7;  // Jan 1 1970 was a Thursday
+    if (days >= first + length) {
+      days -= 7;  // there are only four of these weekdays this month
+    }
+  }
+  return (int64_t)days * (int64_t)SECS_PER_DAY + rule.time - wallOffset;
+}
+
+// t clamped to the 32 bit range of time_t
+static inline uint32_t clampTime(int64_t t) {
+  return t < 0 ? 0 : (t > 0xFFFFFFFFLL ? 0xFFFFFFFFUL : (uint32_t)t);
+}
+
+// the offset at utc, updating the cache when utc is outside the cached year
+long TimeZone::lookup(uint32_t utc) const {
+  uint32_t s = seqLoad(&seq);
+  uint32_t cuts[4];  // the year, cut into three periods at its transitions; from <= cut <= until, never wrapping
+  uint32_t dstPeriods = 0;
+  bool cachedYear = false;
+  if (s != 0 && !(s & 1)) {
+    cuts[0] = relaxedLoad(&yearFrom);
+    cuts[1] = relaxedLoad(&yearCuts[0]);
+    cuts[2] = relaxedLoad(&yearCuts[1]);
+    cuts[3] = relaxedLoad(&yearUntil);
+    dstPeriods = relaxedLoad(&yearDst);
+    seqReadDone();
+    cachedYear = relaxedLoad(&seq) == s && utc >= cuts[0] && utc < cuts[3];
+  } else {
+    s &= ~1UL;
+  }
+  if (!cachedYear) {
+    // the transitions of the UTC year of utc decide, as in glibc, even where a rule time moves
+    // one into the next or previous year
+    long year = timeYear(utc);
+    int64_t from = (int64_t)daysBeforeYear(year) * (int64_t)SECS_PER_DAY;
+    int64_t until = (int64_t)daysBeforeYear(year + 1) * (int64_t)SECS_PER_DAY;
+    int64_t start = transition(dstStart, year, stdOffset);
+    int64_t end = transition(dstEnd, year, dstOffset);
+    // daylight saving time is from start to end, or outside end to start in the southern hemisphere
+    bool southern = end < start;
+    int64_t first = southern ? end : start, second = southern ? start : end;
+    first = first < from ? from : (first > until ? until : first);  // a transition in the next or previous year
+    second = second < first ? first : (second > until ? until : second);
+    cuts[0] = clampTime(from);
+    cuts[1] = clampTime(first);
+    cuts[2] = clampTime(second);
+    cuts[3] = clampTime(until);
+    dstPeriods = southern ? 5 : 2;  // bit i is set when period i is daylight saving time
+  }
+
+  int period = utc < cuts[1] ? 0 : (utc < cuts[2] ? 1 : 2);
+  long result = (dstPeriods >> period & 1) ? dstOffset : stdOffset;
+
+  if (seqLock(&seq, s)) {
+    relaxedStore(&from, cuts[period]);
+    relaxedStore(&until, cuts[period + 1]);
+    relaxedStore(&cachedOffset, result);
+    relaxedStore(&yearFrom, cuts[0]);
+    relaxedStore(&yearCuts[0], cuts[1]);
+    relaxedStore(&yearCuts[1], cuts[2]);
+    relaxedStore(&yearUntil, cuts[3]);
+    relaxedStore(&yearDst, dstPeriods);
+    seqUnlock(&seq, s);
+  }
+  return result;
+}
+
+long TimeZone::offset(time_t utc) const {
+  if (!hasDst) {
+    return stdOffset;
+  }
+  uint32_t t = (uint32_t)utc;
+  uint32_t s = seqLoad(&seq);
+  if (s != 0 && !(s & 1)) {
+    uint32_t f = relaxedLoad(&from);
+    uint32_t u = relaxedLoad(&until);
+    long o = relaxedLoad(&cachedOffset);
+    seqReadDone();
+    if (relaxedLoad(&seq) == s && t - f < u - f) {
+      return o;
+    }
+  }
+  return lookup(t);
+}
+
+bool TimeZone::isDst(time_t utc) const {
+  return hasDst && offset(utc) == dstOffset && dstOffset != stdOffset;
+}
+
+const char* TimeZone::name(time_t utc) const {
+  return isDst(utc) ? dstName : stdName;
+}
+
+time_t TimeZone::toUtc(time_t local) const {
+  if (hasDst) {
+    time_t utc = local - dstOffset;
+    if (offset(utc) == dstOffset) {
+      return utc;
+    }
+  }
+  return local - stdOffset;
+}
+
+static TimeZone zone;
+
+bool TimeClass::setTimeZone(const char* tz) {
+  return zone.set(tz);
+}
+
+void TimeClass::setTimeZone(const TimeZone& z) {
+  zone = z;
+}
+
+const TimeZone& TimeClass::timeZone() {
+  return zone;
+}
 
 /* return string representation for the given time */
 String TimeClass::timeStr(time_t t)
 {
-    t += time_zone_cache;
-    t += dst_current_cache;
-    struct tm calendar_time = {};
-    localtime_r(&t, &calendar_time);
-    char ascstr[26] = {};
-    asctime_r(&calendar_time, ascstr);
-    int len = strlen(ascstr);
-    ascstr[len-1] = 0; // remove final newline
-    return String(ascstr);
+    static const TimeFormat asctimeFormat(TIME_FORMAT_DEFAULT);
+    char buf[32];
+    formatTo(buf, sizeof(buf), t, asctimeFormat);
+    return String(buf);
 }
 
 const char* TimeClass::format_spec = TIME_FORMAT_DEFAULT;
-struct tm TimeClass::_tm;
+TimeFormat TimeClass::compiledFormat(TIME_FORMAT_DEFAULT);
 
 String TimeClass::format(time_t t, const char* format_spec)
 {
-    if (format_spec == nullptr)
-        format_spec = this->format_spec;
-
-    if (!format_spec || !strcmp(format_spec, TIME_FORMAT_DEFAULT)) {
-        return timeStr(t);
+    char buf[128];
+    if (format_spec == nullptr) {
+        formatTo(buf, sizeof(buf), t, compiledFormat);
+    } else {
+        formatTo(buf, sizeof(buf), t, TimeFormat(format_spec));
     }
-    t += time_zone_cache;
-    t += dst_current_cache;
-    struct tm calendar_time = {};
-    localtime_r(&t, &calendar_time);
-    return timeFormatImpl(&calendar_time, format_spec, time_zone_cache + dst_current_cache);
+    return String(buf);
 }
 
-#ifndef t_abs
-#define t_abs(x) ((x)>0?(x):-(x))
-#endif
-
-String TimeClass::timeFormatImpl(tm* calendar_time, const char* format, int time_zone)
+size_t TimeClass::formatTo(char* buf, size_t size, time_t t)
 {
-    char format_str[64];
-    // only copy up to n-1 to dest if no null terminator found
-    strncpy(format_str, format, sizeof(format_str) - 1); // Flawfinder: ignore (ch42318)
-    format_str[sizeof(format_str) - 1] = '\0'; // ensure null termination
-    size_t len = strlen(format_str); // Flawfinder: ignore (ch42318)
-
-    char time_zone_str[16];
-    // while we are not using stdlib for managing the timezone, we have to do this manually
-    if (!time_zone) {
-        strcpy(time_zone_str, "Z");
-    }
-    else {
-        snprintf(time_zone_str, sizeof(time_zone_str), "%+03d:%02u", time_zone/3600, t_abs(time_zone/60)%60);
-    }
-
-    // replace %z with the timezone
-    for (size_t i=0; i<len-1; i++)
-    {
-        if (format_str[i]=='%' && format_str[i+1]=='z')
-        {
-            size_t tzlen = strlen(time_zone_str);
-            memcpy(format_str+i+tzlen, format_str+i+2, len-i-1);    // +1 include the 0 char
-            memcpy(format_str+i, time_zone_str, tzlen);
-            len = strlen(format_str);
-        }
-    }
+    return formatTo(buf, size, t, compiledFormat);
+}
 
-    char buf[50] = {};
-    strftime(buf, sizeof(buf), format_str, calendar_time);
-    return String(buf);
+size_t TimeClass::formatTo(char* buf, size_t size, time_t t, const TimeFormat& format)
+{
+    long offset = zone.offset(t);
+    return format.formatTo(buf, size, t + offset, offset);
 }
 
@@ -0,0 +1,428 @@
+/* TimeBatch.cpp
+ * Bulk conversion between arrays of time_t and columns of time elements for use with the Time library
+ *
+ * On x86 the SSE2 and AVX2 kernels are compiled with per function target attributes, so the
+ * library itself does not need to be built with -mavx2. The kernel is picked on the first call
+ * from the features of the running CPU. All other targets use the portable loop.
+ *
+ * The kernels do the integer divisions in floating point. For an integer a, (a + 1/2) / b is at
+ * least 1/2b away from the next integer, so truncating its product with the rounded reciprocal
+ * of b gives the exact quotient in single precision for 0 <= a < 2^22, and in double precision
+ * for any 32 bit value. The only negative dividends, -1 and -2 for year 0 in makeTimeBatch(),
+ * also truncate to 0 as the C division does. Each element therefore gives exactly the same result
+ * as breakTime() and makeTime().
+ */
+
+#if ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+
+#include <string.h>
+#include "TimeLib.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) && defined(__GNUC__)
+#define TIME_BATCH_X86
+#include <immintrin.h>
+#endif
+
+static tmColumns_t advanceColumns(const tmColumns_t& columns, size_t n)
+{
+    tmColumns_t c = columns;
+    c.year += n;
+    c.month += n;
+    c.day += n;
+    c.hour += n;
+    c.minute += n;
+    c.second += n;
+    if (c.wday)
+        c.wday += n;
+    return c;
+}
+
+static void breakTimeScalar(const time_t* times, size_t count, const tmColumns_t& c)
+{
+    tm tme;
+    for (size_t i = 0; i < count; i++) {
+        TimeClass::breakTime(times[i], tme);
+        c.year[i] = tmYearToCalendar(tme.tm_year);
+        c.month[i] = tme.tm_mon;
+        c.day[i] = tme.tm_mday;
+        c.hour[i] = tme.tm_hour;
+        c.minute[i] = tme.tm_min;
+        c.second[i] = tme.tm_sec;
+        c.wday[i] = tme.tm_wday;
+    }
+}
+
+static void makeTimeScalar(const tmColumns_t& c, size_t count, time_t* times)
+{
+    tm tme = {};
+    for (size_t i = 0; i < count; i++) {
+        tme.tm_year = CalendarYrToTm(c.year[i]);
+        tme.tm_mon = c.month[i];
+        tme.tm_mday = c.day[i];
+        tme.tm_hour = c.hour[i];
+        tme.tm_min = c.minute[i];
+        tme.tm_sec = c.second[i];
+        times[i] = TimeClass::makeTime(tme);
+    }
+}
+
+#ifdef TIME_BATCH_X86
+
+/*==============================================================================*/
+/* SSE2, 4 elements per step */
+
+// a/b rounded towards zero
+static inline __m128 sse2_div(__m128 a, float b)
+{
+    __m128 q = _mm_mul_ps(_mm_add_ps(a, _mm_set1_ps(0.5f)), _mm_set1_ps(1.0f / b));
+    return _mm_cvtepi32_ps(_mm_cvttps_epi32(q));
+}
+
+static inline __m128 sse2_mul(__m128 a, float b)
+{
+    return _mm_mul_ps(a, _mm_set1_ps(b));
+}
+
+static inline __m128 sse2_add(__m128 a, float b)
+{
+    return _mm_add_ps(a, _mm_set1_ps(b));
+}
+
+// low 32 bits of the product of each lane, SSE2 lacks pmulld
+static inline __m128i sse2_mullo(__m128i a, __m128i b)
+{
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// the low 32 bits of 4 time_t values, as breakTime() truncates its argument
+static inline __m128i sse2_loadTimes(const time_t* t)
+{
+    if (sizeof(time_t) == 8) {
+        __m128 lo = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)t));
+        __m128 hi = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)t + 1));
+        return _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+    }
+    return _mm_loadu_si128((const __m128i*)t);
+}
+
+// unsigned seconds are split into whole days and the seconds of the day in double precision
+static inline void sse2_splitDays(__m128i t, __m128& days, __m128& secs)
+{
+    const __m128d two31 = _mm_set1_pd(2147483648.0);
+    const __m128d secsPerDay = _mm_set1_pd(86400.0);
+    __m128i biased = _mm_xor_si128(t, _mm_set1_epi32((int)0x80000000));
+    __m128d t0 = _mm_add_pd(_mm_cvtepi32_pd(biased), two31);
+    __m128d t1 = _mm_add_pd(_mm_cvtepi32_pd(_mm_srli_si128(biased, 8)), two31);
+    __m128d d0 = _mm_cvtepi32_pd(_mm_cvttpd_epi32(_mm_div_pd(t0, secsPerDay)));
+    __m128d d1 = _mm_cvtepi32_pd(_mm_cvttpd_epi32(_mm_div_pd(t1, secsPerDay)));
+    __m128d s0 = _mm_sub_pd(t0, _mm_mul_pd(d0, secsPerDay));
+    __m128d s1 = _mm_sub_pd(t1, _mm_mul_pd(d1, secsPerDay));
+    days = _mm_movelh_ps(_mm_cvtpd_ps(d0), _mm_cvtpd_ps(d1));
+    secs = _mm_movelh_ps(_mm_cvtpd_ps(s0), _mm_cvtpd_ps(s1));
+}
+
+static inline void sse2_storeU8(uint8_t* p, __m128 v)
+{
+    __m128i i = _mm_cvttps_epi32(v);
+    __m128i b = _mm_packus_epi16(_mm_packs_epi32(i, i), i);
+    int32_t bytes = _mm_cvtsi128_si32(b);
+    memcpy(p, &bytes, 4);
+}
+
+static inline void sse2_storeU16(uint16_t* p, __m128 v)
+{
+    __m128i i = _mm_cvttps_epi32(v);
+    _mm_storel_epi64((__m128i*)p, _mm_packs_epi32(i, i));
+}
+
+static inline __m128i sse2_loadU8(const uint8_t* p)
+{
+    int32_t bytes;
+    memcpy(&bytes, p, 4);
+    __m128i zero = _mm_setzero_si128();
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+}
+
+static inline __m128i sse2_loadU16(const uint16_t* p)
+{
+    return _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128());
+}
+
+static void breakTimeSSE2(const time_t* times, size_t count, const tmColumns_t& c)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 days, secs;
+        sse2_splitDays(sse2_loadTimes(times + i), days, secs);
+
+        __m128 hour = sse2_div(secs, 3600);
+        secs = _mm_sub_ps(secs, sse2_mul(hour, 3600));
+        __m128 minute = sse2_div(secs, 60);
+        secs = _mm_sub_ps(secs, sse2_mul(minute, 60));
+        __m128 w = sse2_add(days, 4);
+        __m128 wday = sse2_add(_mm_sub_ps(w, sse2_mul(sse2_div(w, 7), 7)), 1);
+
+        // see breakTime() for the derivation
+        __m128 z = sse2_add(days, 719468);
+        __m128 era = sse2_div(z, 146097);
+        __m128 doe = _mm_sub_ps(z, sse2_mul(era, 146097));
+        __m128 yoe = sse2_div(_mm_add_ps(_mm_sub_ps(doe, sse2_div(doe, 1460)),
+                                         _mm_sub_ps(sse2_div(doe, 36524), sse2_div(doe, 146096))), 365);
+        __m128 doy = _mm_sub_ps(doe, _mm_sub_ps(_mm_add_ps(sse2_mul(yoe, 365), sse2_div(yoe, 4)), sse2_div(yoe, 100)));
+        __m128 mp = sse2_div(sse2_add(sse2_mul(doy, 5), 2), 153);
+        __m128 mday = sse2_add(_mm_sub_ps(doy, sse2_div(sse2_add(sse2_mul(mp, 153), 2), 5)), 1);
+        __m128 janFeb = _mm_and_ps(_mm_cmpge_ps(mp, _mm_set1_ps(10)), _mm_set1_ps(1));
+        __m128 month = _mm_sub_ps(sse2_add(mp, 3), sse2_mul(janFeb, 12));
+        __m128 year = _mm_add_ps(_mm_add_ps(sse2_mul(era, 400), yoe), janFeb);
+
+        sse2_storeU16(c.year + i, year);
+        sse2_storeU8(c.month + i, month);
+        sse2_storeU8(c.day + i, mday);
+        sse2_storeU8(c.hour + i, hour);
+        sse2_storeU8(c.minute + i, minute);
+        sse2_storeU8(c.second + i, secs);
+        sse2_storeU8(c.wday + i, wday);
+    }
+    breakTimeScalar(times + i, count - i, advanceColumns(c, i));
+}
+
+static void makeTimeSSE2(const tmColumns_t& c, size_t count, time_t* times)
+{
+    const __m128 zero = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i yearInt = sse2_loadU16(c.year + i);
+        __m128 year = _mm_cvtepi32_ps(yearInt);
+        __m128 month = sse2_add(_mm_cvtepi32_ps(sse2_loadU8(c.month + i)), -1);  // 0-254
+        __m128 day = _mm_cvtepi32_ps(sse2_loadU8(c.day + i));
+
+        // carry whole years out of the month, the shifted dividend keeps truncation equal to floor
+        __m128 carry = sse2_add(sse2_div(sse2_add(month, 12), 12), -1);
+        month = _mm_sub_ps(month, sse2_mul(carry, 12));
+        year = _mm_add_ps(year, carry);
+        yearInt = _mm_add_epi32(yearInt, _mm_cvttps_epi32(carry));
+
+        __m128 prev = sse2_add(year, -1);
+        __m128 leapDays = sse2_add(_mm_add_ps(_mm_sub_ps(sse2_div(prev, 4), sse2_div(prev, 100)), sse2_div(prev, 400)), -477);
+        __m128 isLeap = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(year, zero),
+                                              _mm_cmpeq_ps(year, sse2_mul(sse2_div(year, 4), 4))),
+                                   _mm_or_ps(_mm_cmpneq_ps(year, sse2_mul(sse2_div(year, 100), 100)),
+                                             _mm_cmpeq_ps(year, sse2_mul(sse2_div(year, 400), 400))));
+        // days before the month in a common year is (367 * month - 362) / 12, less 2 after February
+        __m128 pastFeb = _mm_cmpgt_ps(month, _mm_set1_ps(1));
+        __m128 febAdjust = _mm_and_ps(pastFeb, _mm_sub_ps(_mm_and_ps(isLeap, _mm_set1_ps(1)), _mm_set1_ps(2)));
+        __m128 monthDays = _mm_add_ps(sse2_div(sse2_add(sse2_mul(month, 367), 5), 12), febAdjust);
+        __m128 dayInEra = _mm_add_ps(_mm_add_ps(leapDays, monthDays), sse2_add(day, -1));
+
+        __m128i days = _mm_add_epi32(sse2_mullo(_mm_sub_epi32(yearInt, _mm_set1_epi32(1970)), _mm_set1_epi32(365)),
+                                     _mm_cvttps_epi32(dayInEra));
+        __m128 secs = _mm_add_ps(_mm_add_ps(sse2_mul(_mm_cvtepi32_ps(sse2_loadU8(c.hour + i)), 3600),
+                                            sse2_mul(_mm_cvtepi32_ps(sse2_loadU8(c.minute + i)), 60)),
+                                 _mm_cvtepi32_ps(sse2_loadU8(c.second + i)));
+        __m128i seconds = _mm_add_epi32(sse2_mullo(days, _mm_set1_epi32(86400)), _mm_cvttps_epi32(secs));
+
+        if (sizeof(time_t) == 8) {
+            _mm_storeu_si128((__m128i*)(times + i), _mm_unpacklo_epi32(seconds, _mm_setzero_si128()));
+            _mm_storeu_si128((__m128i*)(times + i) + 1, _mm_unpackhi_epi32(seconds, _mm_setzero_si128()));
+        } else {
+            _mm_storeu_si128((__m128i*)(times + i), seconds);
+        }
+    }
+    makeTimeScalar(advanceColumns(c, i), count - i, times + i);
+}
+
+/*==============================================================================*/
+/* AVX2, 8 elements per step */
+
+#define TIME_AVX2 __attribute__((target("avx2")))
+
+TIME_AVX2 static inline __m256 avx2_div(__m256 a, float b)
+{
+    __m256 q = _mm256_mul_ps(_mm256_add_ps(a, _mm256_set1_ps(0.5f)), _mm256_set1_ps(1.0f / b));
+    return _mm256_round_ps(q, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+}
+
+TIME_AVX2 static inline __m256 avx2_mul(__m256 a, float b)
+{
+    return _mm256_mul_ps(a, _mm256_set1_ps(b));
+}
+
+TIME_AVX2 static inline __m256 avx2_add(__m256 a, float b)
+{
+    return _mm256_add_ps(a, _mm256_set1_ps(b));
+}
+
+TIME_AVX2 static inline __m256i avx2_loadTimes(const time_t* t)
+{
+    if (sizeof(time_t) == 8) {
+        const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+        __m128i lo = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)t), even));
+        __m128i hi = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)t + 1), even));
+        return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+    }
+    return _mm256_loadu_si256((const __m256i*)t);
+}
+
+TIME_AVX2 static inline void avx2_splitDays(__m256i t, __m256& days, __m256& secs)
+{
+    const __m256d two31 = _mm256_set1_pd(2147483648.0);
+    const __m256d secsPerDay = _mm256_set1_pd(86400.0);
+    __m256i biased = _mm256_xor_si256(t, _mm256_set1_epi32((int)0x80000000));
+    __m256d t0 = _mm256_add_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(biased)), two31);
+    __m256d t1 = _mm256_add_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(biased, 1)), two31);
+    __m256d d0 = _mm256_round_pd(_mm256_div_pd(t0, secsPerDay), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    __m256d d1 = _mm256_round_pd(_mm256_div_pd(t1, secsPerDay), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    __m256d s0 = _mm256_sub_pd(t0, _mm256_mul_pd(d0, secsPerDay));
+    __m256d s1 = _mm256_sub_pd(t1, _mm256_mul_pd(d1, secsPerDay));
+    days = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(d0)), _mm256_cvtpd_ps(d1), 1);
+    secs = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(s0)), _mm256_cvtpd_ps(s1), 1);
+}
+
+TIME_AVX2 static inline void avx2_storeU8(uint8_t* p, __m256 v)
+{
+    __m256i i = _mm256_cvttps_epi32(v);
+    __m128i w = _mm_packs_epi32(_mm256_castsi256_si128(i), _mm256_extracti128_si256(i, 1));
+    _mm_storel_epi64((__m128i*)p, _mm_packus_epi16(w, w));
+}
+
+TIME_AVX2 static inline void avx2_storeU16(uint16_t* p, __m256 v)
+{
+    __m256i i = _mm256_cvttps_epi32(v);
+    _mm_storeu_si128((__m128i*)p, _mm_packs_epi32(_mm256_castsi256_si128(i), _mm256_extracti128_si256(i, 1)));
+}
+
+TIME_AVX2 static inline __m256i avx2_loadU8(const uint8_t* p)
+{
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p));
+}
+
+TIME_AVX2 static void breakTimeAVX2(const time_t* times, size_t count, const tmColumns_t& c)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 days, secs;
+        avx2_splitDays(avx2_loadTimes(times + i), days, secs);
+
+        __m256 hour = avx2_div(secs, 3600);
+        secs = _mm256_sub_ps(secs, avx2_mul(hour, 3600));
+        __m256 minute = avx2_div(secs, 60);
+        secs = _mm256_sub_ps(secs, avx2_mul(minute, 60));
+        __m256 w = avx2_add(days, 4);
+        __m256 wday = avx2_add(_mm256_sub_ps(w, avx2_mul(avx2_div(w, 7), 7)), 1);
+
+        __m256 z = avx2_add(days, 719468);
+        __m256 era = avx2_div(z, 146097);
+        __m256 doe = _mm256_sub_ps(z, avx2_mul(era, 146097));
+        __m256 yoe = avx2_div(_mm256_add_ps(_mm256_sub_ps(doe, avx2_div(doe, 1460)),
+                                            _mm256_sub_ps(avx2_div(doe, 36524), avx2_div(doe, 146096))), 365);
+        __m256 doy = _mm256_sub_ps(doe, _mm256_sub_ps(_mm256_add_ps(avx2_mul(yoe, 365), avx2_div(yoe, 4)), avx2_div(yoe, 100)));
+        __m256 mp = avx2_div(avx2_add(avx2_mul(doy, 5), 2), 153);
+        __m256 mday = avx2_add(_mm256_sub_ps(doy, avx2_div(avx2_add(avx2_mul(mp, 153), 2), 5)), 1);
+        __m256 janFeb = _mm256_and_ps(_mm256_cmp_ps(mp, _mm256_set1_ps(10), _CMP_GE_OQ), _mm256_set1_ps(1));
+        __m256 month = _mm256_sub_ps(avx2_add(mp, 3), avx2_mul(janFeb, 12));
+        __m256 year = _mm256_add_ps(_mm256_add_ps(avx2_mul(era, 400), yoe), janFeb);
+
+        avx2_storeU16(c.year + i, year);
+        avx2_storeU8(c.month + i, month);
+        avx2_storeU8(c.day + i, mday);
+        avx2_storeU8(c.hour + i, hour);
+        avx2_storeU8(c.minute + i, minute);
+        avx2_storeU8(c.second + i, secs);
+        avx2_storeU8(c.wday + i, wday);
+    }
+    breakTimeScalar(times + i, count - i, advanceColumns(c, i));
+}
+
+TIME_AVX2 static void makeTimeAVX2(const tmColumns_t& c, size_t count, time_t* times)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i yearInt = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(c.year + i)));
+        __m256 year = _mm256_cvtepi32_ps(yearInt);
+        __m256 month = avx2_add(_mm256_cvtepi32_ps(avx2_loadU8(c.month + i)), -1);
+        __m256 day = _mm256_cvtepi32_ps(avx2_loadU8(c.day + i));
+
+        __m256 carry = avx2_add(avx2_div(avx2_add(month, 12), 12), -1);
+        month = _mm256_sub_ps(month, avx2_mul(carry, 12));
+        year = _mm256_add_ps(year, carry);
+        yearInt = _mm256_add_epi32(yearInt, _mm256_cvttps_epi32(carry));
+
+        __m256 prev = avx2_add(year, -1);
+        __m256 leapDays = avx2_add(_mm256_add_ps(_mm256_sub_ps(avx2_div(prev, 4), avx2_div(prev, 100)), avx2_div(prev, 400)), -477);
+        __m256 isLeap = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(year, zero, _CMP_GT_OQ),
+                                                    _mm256_cmp_ps(year, avx2_mul(avx2_div(year, 4), 4), _CMP_EQ_OQ)),
+                                      _mm256_or_ps(_mm256_cmp_ps(year, avx2_mul(avx2_div(year, 100), 100), _CMP_NEQ_OQ),
+                                                   _mm256_cmp_ps(year, avx2_mul(avx2_div(year, 400), 400), _CMP_EQ_OQ)));
+        __m256 pastFeb = _mm256_cmp_ps(month, _mm256_set1_ps(1), _CMP_GT_OQ);
+        __m256 febAdjust = _mm256_and_ps(pastFeb, _mm256_sub_ps(_mm256_and_ps(isLeap, _mm256_set1_ps(1)), _mm256_set1_ps(2)));
+        __m256 monthDays = _mm256_add_ps(avx2_div(avx2_add(avx2_mul(month, 367), 5), 12), febAdjust);
+        __m256 dayInEra = _mm256_add_ps(_mm256_add_ps(leapDays, monthDays), avx2_add(day, -1));
+
+        __m256i days = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(yearInt, _mm256_set1_epi32(1970)), _mm256_set1_epi32(365)),
+                                        _mm256_cvttps_epi32(dayInEra));
+        __m256 secs = _mm256_add_ps(_mm256_add_ps(avx2_mul(_mm256_cvtepi32_ps(avx2_loadU8(c.hour + i)), 3600),
+                                                  avx2_mul(_mm256_cvtepi32_ps(avx2_loadU8(c.minute + i)), 60)),
+                                    _mm256_cvtepi32_ps(avx2_loadU8(c.second + i)));
+        __m256i seconds = _mm256_add_epi32(_mm256_mullo_epi32(days, _mm256_set1_epi32(86400)), _mm256_cvttps_epi32(secs));
+
+        if (sizeof(time_t) == 8) {
+            _mm256_storeu_si256((__m256i*)(times + i), _mm256_cvtepu32_epi64(_mm256_castsi256_si128(seconds)));
+            _mm256_storeu_si256((__m256i*)(times + i) + 1, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(seconds, 1)));
+        } else {
+            _mm256_storeu_si256((__m256i*)(times + i), seconds);
+        }
+    }
+    makeTimeScalar(advanceColumns(c, i), count - i, times + i);
+}
+
+#endif // TIME_BATCH_X86
+
+/*==============================================================================*/
+
+typedef void (*breakTimeKernel)(const time_t*, size_t, const tmColumns_t&);
+typedef void (*makeTimeKernel)(const tmColumns_t&, size_t, time_t*);
+
+static breakTimeKernel breakKernel;
+static makeTimeKernel makeKernel;
+
+static void selectKernels()
+{
+#ifdef TIME_BATCH_X86
+#ifdef TIME_BATCH_NO_AVX2   // define this to use the SSE2 kernels on any x86, as the host tests do
+    if (false) {
+#else
+    if (__builtin_cpu_supports("avx2")) {
+#endif
+        makeKernel = makeTimeAVX2;
+        breakKernel = breakTimeAVX2;
+    } else {
+        makeKernel = makeTimeSSE2;
+        breakKernel = breakTimeSSE2;
+    }
+#else
+    makeKernel = makeTimeScalar;
+    breakKernel = breakTimeScalar;
+#endif
+}
+
+void TimeClass::breakTimeBatch(const time_t* times, size_t count, const tmColumns_t& columns)
+{
+    if (!breakKernel)
+        selectKernels();
+    breakKernel(times, count, columns);
+}
+
+void TimeClass::makeTimeBatch(const tmColumns_t& columns, size_t count, time_t* times)
+{
+    if (!breakKernel)
+        selectKernels();
+    makeKernel(columns, count, times);
+}
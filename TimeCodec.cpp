@@ -0,0 +1,233 @@
+/* TimeCodec.cpp
+ * Delta of delta encoding of timestamp streams for use with the Time library
+ *
+ * Times logged at a steady rate have nearly constant differences, so the change of the
+ * difference is mostly 0 or a few milliseconds of jitter. Zigzag maps small changes of either
+ * sign to small numbers, and the varint writes 7 bits per byte, so changes up to +-63 take a
+ * single byte. The decoder's common case, a one byte record, is a shift and two additions.
+ */
+
+#if ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+
+#include <string.h>
+#include "TimeLib.h"
+
+static inline size_t putVarint(uint64_t v, uint8_t* buf)
+{
+    size_t n = 0;
+    while (v >= 0x80) {
+        buf[n++] = (uint8_t)v | 0x80;
+        v >>= 7;
+    }
+    buf[n++] = (uint8_t)v;
+    return n;
+}
+
+// false if the varint runs past the end or is longer than 64 bits
+static inline bool getVarint(const uint8_t* data, size_t size, size_t& pos, uint64_t& v)
+{
+    v = 0;
+    for (uint8_t shift = 0; pos < size && shift < 64; shift += 7) {
+        uint8_t b = data[pos++];
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (b < 0x80) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline uint64_t zigzag(int64_t x)
+{
+    return ((uint64_t)x << 1) ^ (uint64_t)(x >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t z)
+{
+    return (int64_t)(z >> 1) ^ -(int64_t)(z & 1);
+}
+
+/* encoder */
+
+TimeEncoder::TimeEncoder(bool keepMilliseconds, uint16_t keyframeInterval)
+{
+    milliseconds = keepMilliseconds;
+    interval = keyframeInterval != 0 ? keyframeInterval : 1;
+    previous = 0;
+    previousDelta = 0;
+    reset();
+}
+
+void TimeEncoder::reset()
+{
+    sinceKeyframe = interval;
+}
+
+size_t TimeEncoder::encode(time_t t, uint8_t* buf, size_t size)
+{
+    return encodeMs((time_ms_t)t * 1000, buf, size);
+}
+
+size_t TimeEncoder::encodeMs(time_ms_t t, uint8_t* buf, size_t size)
+{
+    int64_t value = milliseconds ? t : t / 1000;
+    uint8_t record[TIME_CODEC_MAX_RECORD];
+    size_t n;
+    int64_t delta = 0;
+    bool keyframe = sinceKeyframe >= interval;
+    if (keyframe) {
+        record[0] = 0;
+        n = 1 + putVarint(((uint64_t)value << 1) | (milliseconds ? 1 : 0), record + 1);
+    } else {
+        delta = value - previous;
+        n = putVarint(zigzag(delta - previousDelta) + 1, record);
+    }
+    if (n > size) {
+        return 0;  // nothing changes, the time can be given again with more room
+    }
+    memcpy(buf, record, n);
+    previous = value;
+    previousDelta = delta;
+    sinceKeyframe = keyframe ? 1 : sinceKeyframe + 1;
+    return n;
+}
+
+/* decoder */
+
+TimeDecoder::TimeDecoder(const uint8_t* bytes, size_t length)
+{
+    data = bytes;
+    size = length;
+    pos = 0;
+    previous = 0;
+    previousDelta = 0;
+    started = false;
+    milliseconds = false;
+}
+
+bool TimeDecoder::nextMs(time_ms_t& t)
+{
+    if (pos >= size) {
+        return false;
+    }
+    size_t p = pos;
+    uint64_t v;
+    if (data[p] == 0) {
+        p++;
+        if (!getVarint(data, size, p, v)) {
+            return false;
+        }
+        milliseconds = v & 1;
+        previous = (int64_t)(v >> 1);
+        previousDelta = 0;
+        started = true;
+    } else {
+        if (!started || !getVarint(data, size, p, v)) {
+            return false;  // the data must start with a keyframe
+        }
+        previousDelta += unzigzag(v - 1);
+        previous += previousDelta;
+    }
+    pos = p;
+    t = milliseconds ? previous : previous * 1000;
+    return true;
+}
+
+bool TimeDecoder::next(time_t& t)
+{
+    time_ms_t ms;
+    if (!nextMs(ms)) {
+        return false;
+    }
+    t = (time_t)(ms / 1000);
+    return true;
+}
+
+size_t TimeDecoder::decodeMs(time_ms_t* times, size_t count)
+{
+    size_t i = 0;
+    // one byte records in local variables, anything else through nextMs()
+    int64_t value = previous, delta = previousDelta;
+    int64_t scale = milliseconds ? 1 : 1000;
+    while (i < count && pos < size) {
+        uint8_t b = data[pos];
+        if (started && b != 0 && b < 0x80) {
+            delta += unzigzag(b - 1);
+            value += delta;
+            pos++;
+            times[i++] = value * scale;
+            continue;
+        }
+        previous = value;
+        previousDelta = delta;
+        if (!nextMs(times[i])) {
+            return i;
+        }
+        i++;
+        value = previous;
+        delta = previousDelta;
+        scale = milliseconds ? 1 : 1000;
+    }
+    previous = value;
+    previousDelta = delta;
+    return i;
+}
+
+size_t TimeDecoder::decode(time_t* times, size_t count)
+{
+    time_ms_t ms[16];
+    size_t done = 0;
+    while (done < count) {
+        size_t n = decodeMs(ms, count - done < 16 ? count - done : 16);
+        for (size_t i = 0; i < n; i++) {
+            times[done + i] = (time_t)(ms[i] / 1000);
+        }
+        done += n;
+        if (n < 16) {
+            break;
+        }
+    }
+    return done;
+}
+
+bool TimeDecoder::seekMs(time_ms_t t)
+{
+    // find the last keyframe at or before t; outside a keyframe only a keyframe starts with a 0
+    // byte, so memchr() hops from one to the next without looking at the records between them
+    size_t p = 0, keyframe = 0;
+    while (p < size) {
+        const uint8_t* marker = (const uint8_t*)memchr(data + p, 0, size - p);
+        if (marker == NULL) {
+            break;
+        }
+        size_t start = marker - data;
+        p = start + 1;
+        uint64_t v;
+        if (!getVarint(data, size, p, v)) {
+            break;
+        }
+        int64_t keyTime = (v & 1) ? (int64_t)(v >> 1) : (int64_t)(v >> 1) * 1000;
+        if (keyTime > t) {
+            break;
+        }
+        keyframe = start;
+    }
+
+    pos = keyframe;
+    started = false;
+    for (;;) {
+        TimeDecoder before = *this;
+        time_ms_t ms;
+        if (!nextMs(ms)) {
+            return false;
+        }
+        if (ms >= t) {
+            *this = before;  // so next() gives this time
+            return true;
+        }
+    }
+}
@@ -0,0 +1,413 @@
+/* TimeCron.cpp
+ * Cron expressions compiled into bitsets for use with the Time library
+ *
+ * Each field is a mask with a bit for each value it matches. The days of a month that match
+ * depend on the year and month, through the weekday of the 1st and the length of the month, so
+ * they are built as one 32 bit mask when a month is looked at: the weekdays are a pattern with a
+ * bit every 7 days, shifted to the weekday of the 1st. Finding the next time is then a few scans
+ * for the lowest set bit at or after a position: the month, the day in the month's mask, and the
+ * hour, minute and second of the day.
+ */
+
+#if ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+
+#include <string.h>
+#include "TimeLib.h"
+
+#define FIELD_SECOND  0
+#define FIELD_MINUTE  1
+#define FIELD_HOUR    2
+#define FIELD_DAY     3
+#define FIELD_MONTH   4
+#define FIELD_WEEKDAY 5
+
+#define LAST_WEEKDAY  0x20     // in nthWeekday, the last of the weekday in the month
+#define SEARCH_YEARS  400      // the calendar repeats after 400 years, a time that matches is found before
+
+static const uint8_t fieldMin[] = { 0, 0, 0, 1, 1, 0 };
+static const uint8_t fieldMax[] = { 59, 59, 23, 31, 12, 7 };
+static const char monthNames[] = "JANFEBMARAPRMAYJUNJULAUGSEPOCTNOVDEC";
+static const char weekdayNames[] = "SUNMONTUEWEDTHUFRISAT";
+
+// the lowest set bit of mask at or after bit from, -1 if there is none
+static inline int nextBit(uint64_t mask, uint8_t from)
+{
+    if (from >= 64) {
+        return -1;
+    }
+    mask &= ~0ULL << from;
+    return mask != 0 ? __builtin_ctzll(mask) : -1;
+}
+
+static inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+static inline char upper(char c)
+{
+    return (c >= 'a' && c <= 'z') ? c - ('a' - 'A') : c;
+}
+
+// a number, or a month or weekday name
+static bool parseValue(const char*& p, uint8_t field, int& value)
+{
+    if (*p >= '0' && *p <= '9') {
+        value = 0;
+        for (uint8_t n = 0; *p >= '0' && *p <= '9'; n++) {
+            if (n == 2) {
+                return false;
+            }
+            value = value * 10 + (*p++ - '0');
+        }
+        return true;
+    }
+    const char* names = field == FIELD_MONTH ? monthNames : (field == FIELD_WEEKDAY ? weekdayNames : NULL);
+    if (names == NULL || p[0] == 0 || p[1] == 0 || p[2] == 0) {
+        return false;
+    }
+    for (uint8_t i = 0; names[i * 3] != 0; i++) {
+        if (upper(p[0]) == names[i * 3] && upper(p[1]) == names[i * 3 + 1] && upper(p[2]) == names[i * 3 + 2]) {
+            value = field == FIELD_MONTH ? i + 1 : i;
+            p += 3;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*============================================================================*/
+/* compiling */
+
+TimeCron::TimeCron()
+{
+    set(NULL);
+}
+
+TimeCron::TimeCron(const char* spec)
+{
+    set(spec);
+}
+
+bool TimeCron::set(const char* spec)
+{
+    valid = spec != NULL && parse(spec);
+    if (!valid) {
+        seconds = minutes = 0;
+        hours = days = 0;
+        months = 0;
+        weekdays = 0;
+        memset(nthWeekday, 0, sizeof(nthWeekday));
+        lastDay = anyDay = anyWeekday = false;
+    }
+    return valid;
+}
+
+// one comma separated field, p is left after it
+bool TimeCron::parseField(const char*& p, uint8_t field, uint64_t& mask, bool& any)
+{
+    mask = 0;
+    any = (*p == '*' || *p == '?');
+    for (;;) {
+        int lo, hi, step = 1;
+        bool range = false;
+        if (*p == '*' || *p == '?') {
+            p++;
+            lo = fieldMin[field];
+            hi = field == FIELD_WEEKDAY ? 6 : fieldMax[field];
+            range = true;
+        } else if (field == FIELD_DAY && upper(*p) == 'L') {
+            p++;
+            lastDay = true;
+            lo = hi = -1;
+        } else {
+            if (!parseValue(p, field, lo)) {
+                return false;
+            }
+            hi = lo;
+            if (*p == '-') {
+                p++;
+                if (!parseValue(p, field, hi)) {
+                    return false;
+                }
+                range = true;
+            }
+        }
+        if (field == FIELD_WEEKDAY && !range && (*p == '#' || upper(*p) == 'L')) {
+            // the nth or the last of a weekday in the month
+            if (lo > 7) {
+                return false;
+            }
+            if (*p++ == '#') {
+                if (*p < '1' || *p > '5') {
+                    return false;
+                }
+                nthWeekday[lo % 7] |= 1 << (*p++ - '1');
+            } else {
+                nthWeekday[lo % 7] |= LAST_WEEKDAY;
+            }
+            lo = hi = -1;
+        }
+        if (*p == '/') {
+            p++;
+            if (!parseValue(p, FIELD_SECOND, step) || step == 0 || lo < 0) {
+                return false;
+            }
+            if (!range) {
+                hi = fieldMax[field];  // a/n is from a to the end
+            }
+        }
+        if (lo >= 0) {
+            if (lo < fieldMin[field] || hi > fieldMax[field] || lo > hi) {
+                return false;
+            }
+            for (int v = lo; v <= hi; v += step) {
+                mask |= 1ULL << v;
+            }
+        }
+        if (*p != ',') {
+            break;
+        }
+        p++;
+    }
+    return *p == 0 || isSpace(*p);
+}
+
+bool TimeCron::parse(const char* spec)
+{
+    static const char* const shorthands[][2] = {
+        { "@yearly", "0 0 1 1 *" }, { "@annually", "0 0 1 1 *" }, { "@monthly", "0 0 1 * *" },
+        { "@weekly", "0 0 * * 0" }, { "@daily", "0 0 * * *" }, { "@midnight", "0 0 * * *" },
+        { "@hourly", "0 * * * *" },
+    };
+    while (isSpace(*spec)) {
+        spec++;
+    }
+    if (*spec == '@') {
+        for (uint8_t i = 0; i < sizeof(shorthands) / sizeof(shorthands[0]); i++) {
+            if (!strcmp(spec, shorthands[i][0])) {
+                return parse(shorthands[i][1]);
+            }
+        }
+        return false;
+    }
+
+    uint8_t count = 0;
+    for (const char* p = spec; *p; ) {
+        count++;
+        while (*p && !isSpace(*p)) {
+            p++;
+        }
+        while (isSpace(*p)) {
+            p++;
+        }
+    }
+    if (count != 5 && count != 6) {
+        return false;
+    }
+
+    memset(nthWeekday, 0, sizeof(nthWeekday));
+    lastDay = false;
+    uint64_t masks[6];
+    bool any[6];
+    masks[FIELD_SECOND] = 1;  // at second 0 without a seconds field
+    const char* p = spec;
+    for (uint8_t field = count == 6 ? FIELD_SECOND : FIELD_MINUTE; field <= FIELD_WEEKDAY; field++) {
+        if (!parseField(p, field, masks[field], any[field])) {
+            return false;
+        }
+        while (isSpace(*p)) {
+            p++;
+        }
+    }
+    if (masks[FIELD_WEEKDAY] & (1 << 7)) {
+        masks[FIELD_WEEKDAY] = (masks[FIELD_WEEKDAY] & 0x7F) | 1;  // 7 is Sunday
+    }
+    uint8_t nth = 0;
+    for (uint8_t i = 0; i < 7; i++) {
+        nth |= nthWeekday[i];
+    }
+    if (masks[FIELD_SECOND] == 0 || masks[FIELD_MINUTE] == 0 || masks[FIELD_HOUR] == 0 || masks[FIELD_MONTH] == 0 ||
+        (masks[FIELD_DAY] == 0 && !lastDay) || (masks[FIELD_WEEKDAY] == 0 && nth == 0)) {
+        return false;
+    }
+    seconds = masks[FIELD_SECOND];
+    minutes = masks[FIELD_MINUTE];
+    hours = (uint32_t)masks[FIELD_HOUR];
+    days = (uint32_t)masks[FIELD_DAY];
+    months = (uint16_t)masks[FIELD_MONTH];
+    weekdays = (uint8_t)masks[FIELD_WEEKDAY];
+    anyDay = any[FIELD_DAY];
+    anyWeekday = any[FIELD_WEEKDAY];
+    return true;
+}
+
+/*============================================================================*/
+/* matching */
+
+// bit d is set for each day d of the month that matches
+uint32_t TimeCron::dayMask(long year, int month) const
+{
+    uint8_t length = daysInMonth(year, month);
+    uint32_t inMonth = (0xFFFFFFFFUL >> (31 - length)) & ~1UL;  // days 1 to length
+    uint32_t byDay = days | (lastDay ? 1UL << length : 0);
+
+    // the weekdays as a bit every 7 days from the first of each weekday in the month
+    uint8_t first = (uint8_t)((daysFromCivil(year, month, 1) + 4) % 7);  // weekday of the 1st, Sunday is 0
+    uint32_t byWeekday = 0;
+    for (uint8_t w = 0; w < 7; w++) {
+        uint8_t start = (uint8_t)((w + 7 - first) % 7 + 1);
+        if (weekdays & (1 << w)) {
+            byWeekday |= 0x10204081UL << start;  // days start, start + 7 ... start + 28
+        }
+        if (nthWeekday[w] != 0) {
+            for (uint8_t n = 0; n < 5; n++) {
+                if ((nthWeekday[w] & (1 << n)) && start + 7 * n <= length) {
+                    byWeekday |= 1UL << (start + 7 * n);
+                }
+            }
+            if (nthWeekday[w] & LAST_WEEKDAY) {
+                byWeekday |= 1UL << (start + (length - start) / 7 * 7);
+            }
+        }
+    }
+
+    // as in cron, a restricted day and a restricted weekday match either way
+    uint32_t mask;
+    if (anyDay) {
+        mask = anyWeekday ? 0xFFFFFFFFUL : byWeekday;
+    } else if (anyWeekday) {
+        mask = byDay;
+    } else {
+        mask = byDay | byWeekday;
+    }
+    return mask & inMonth;
+}
+
+// the first matching second of the day at or after the given one, -1 if none is left in the day
+long TimeCron::timeOfDay(uint32_t second) const
+{
+    int hour = nextBit(hours, (uint8_t)(second / 3600));
+    if (hour < 0) {
+        return -1;
+    }
+    uint8_t minute = 0, sec = 0;
+    if ((uint32_t)hour == second / 3600) {
+        minute = (uint8_t)(second / 60 % 60);
+        sec = (uint8_t)(second % 60);
+    }
+    for (;;) {
+        int m = nextBit(minutes, minute);
+        if (m >= 0) {
+            int s = nextBit(seconds, m == minute ? sec : 0);
+            if (s >= 0) {
+                return hour * 3600L + m * 60L + s;
+            }
+            if (m < 59) {
+                // no second left in minute m, go on from the next minute of this hour
+                minute = (uint8_t)(m + 1);
+                sec = 0;
+                continue;
+            }
+        }
+        hour = nextBit(hours, (uint8_t)(hour + 1));
+        if (hour < 0) {
+            return -1;
+        }
+        minute = 0;
+        sec = 0;
+    }
+}
+
+bool TimeCron::matches(time_t t) const
+{
+    if (!valid) {
+        return false;
+    }
+    long day = (long)(t / SECS_PER_DAY);
+    uint32_t second = (uint32_t)(t % SECS_PER_DAY);
+    int month = civilMonth(day);
+    return (seconds >> (second % 60) & 1) && (minutes >> (second / 60 % 60) & 1) && (hours >> (second / 3600) & 1) &&
+           (months >> month & 1) && (dayMask(civilYear(day), month) >> civilDay(day) & 1);
+}
+
+time_t TimeCron::next(time_t after) const
+{
+    if (!valid) {
+        return 0;
+    }
+    time_t t = after + 1;
+    long day = (long)(t / SECS_PER_DAY);
+    uint32_t second = (uint32_t)(t % SECS_PER_DAY);
+    long year = civilYear(day);
+    int month = civilMonth(day);
+    int mday = civilDay(day);
+    long lastYear = year + SEARCH_YEARS;
+
+    while (year <= lastYear) {
+        if (months & (1U << month)) {
+            uint32_t candidates = dayMask(year, month) & (0xFFFFFFFFUL << mday);
+            while (candidates != 0) {
+                int d = __builtin_ctzl(candidates);
+                long tod = timeOfDay(d == mday ? second : 0);
+                if (tod >= 0) {
+                    return (time_t)daysFromCivil(year, month, d) * SECS_PER_DAY + tod;
+                }
+                candidates &= candidates - 1;  // nothing left today, a later day matches from midnight
+            }
+        }
+        // the next month that matches, in this year or the next
+        int following = nextBit(months, (uint8_t)(month + 1));
+        if (following < 0) {
+            following = nextBit(months, 1);
+            year++;
+        }
+        month = following;
+        mday = 1;
+        second = 0;
+    }
+    return 0;
+}
+
+time_t TimeCron::next(time_t after, const TimeZone& zone) const
+{
+    time_t local = zone.toLocal(after);
+    for (;;) {
+        local = next(local);
+        if (local == 0) {
+            return 0;
+        }
+        // a local time in an hour the clock repeats converts to its first time, which is not
+        // after `after` the second time round, so the search goes on past the repeated hour
+        time_t utc = zone.toUtc(local);
+        if (utc > after) {
+            return utc;
+        }
+    }
+}
+
+size_t TimeCron::fireTimes(time_t from, time_t until, time_t* times, size_t max) const
+{
+    size_t n = 0;
+    time_t t = next(from > 0 ? from - 1 : 0);  // from itself may match
+    while (n < max && t != 0 && t < until) {
+        times[n++] = t;
+        t = next(t);
+    }
+    return n;
+}
+
+size_t TimeCron::fireTimes(time_t from, time_t until, time_t* times, size_t max, const TimeZone& zone) const
+{
+    size_t n = 0;
+    time_t t = next(from > 0 ? from - 1 : 0, zone);
+    while (n < max && t != 0 && t < until) {
+        times[n++] = t;
+        t = next(t, zone);
+    }
+    return n;
+}
@@ -0,0 +1,437 @@
+/* TimeFormat.cpp
+ * strftime() formats compiled once into a list of operations for use with the Time library
+ *
+ * A format is compiled into a byte code: the conversion letters of the C locale strftime() that
+ * do not depend on the C library stand for themselves, literal text is stored as LITERAL, a
+ * length and the characters, and the composite conversions such as %c and %T are expanded into
+ * their parts unless the format would then not fit. Anything else, such as %Z, the E and O
+ * modifiers or the flags and widths of glibc, is stored as LIBRARY in the same way and left to
+ * strftime(), so the output is the same as before the formats were compiled. Formatting then
+ * writes the elements of the time straight into the caller's buffer, without heap allocation.
+ */
+
+#if ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+
+#include <string.h>
+#include "TimeLib.h"
+
+#define LITERAL 1  // followed by the length and the characters
+#define LIBRARY 2  // followed by the length and the conversion with its flags, width and modifier, formatted by strftime()
+
+static const char weekdayNames[7][10] = { "Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday" };
+static const char monthNames[12][10] = { "January", "February", "March", "April", "May", "June",
+                                         "July", "August", "September", "October", "November", "December" };
+
+// the parts of the composite conversions in the C locale
+static const char* expansion(char c)
+{
+    switch (c) {
+        case 'c': return "%a %b %e %H:%M:%S %Y";
+        case 'D': return "%m/%d/%y";
+        case 'x': return "%m/%d/%y";
+        case 'F': return "%Y-%m-%d";
+        case 'r': return "%I:%M:%S %p";
+        case 'R': return "%H:%M";
+        case 'T': return "%H:%M:%S";
+        case 'X': return "%H:%M:%S";
+        case 'h': return "%b";
+        default: return NULL;
+    }
+}
+
+/*============================================================================*/
+/* compiling */
+
+// append a literal character, extending the literal before it if there is one
+bool TimeFormat::appendLiteral(char c)
+{
+    if (literalStart >= 0 && code[literalStart + 1] < 255) {
+        if (length >= sizeof(code)) {
+            return false;
+        }
+        code[literalStart + 1]++;
+        code[length++] = (uint8_t)c;
+        return true;
+    }
+    if ((size_t)length + 3 > sizeof(code)) {
+        return false;
+    }
+    literalStart = length;
+    code[length++] = LITERAL;
+    code[length++] = 1;
+    code[length++] = (uint8_t)c;
+    return true;
+}
+
+// append an operation, with the directive for LIBRARY
+bool TimeFormat::appendOp(uint8_t op, const char* directive, size_t n)
+{
+    if (length + (op == LIBRARY ? 2 + n : 1) > sizeof(code)) {
+        return false;
+    }
+    literalStart = -1;
+    code[length++] = op;
+    if (op == LIBRARY) {
+        code[length++] = (uint8_t)n;
+        memcpy(&code[length], directive, n);
+        length += n;
+    }
+    return true;
+}
+
+// expand the composite conversions, or if expand is false leave them to strftime() to save space
+bool TimeFormat::compile(const char* spec, bool expand)
+{
+    while (*spec) {
+        if (*spec != '%') {
+            if (!appendLiteral(*spec++)) {
+                return false;
+            }
+            continue;
+        }
+        spec++;
+        char c = *spec;
+        const char* parts = expand ? expansion(c) : NULL;
+        bool ok;
+        if (parts != NULL) {
+            ok = compile(parts, true);
+        } else if (c == '%') {
+            ok = appendLiteral('%');
+        } else if (c == 'n') {
+            ok = appendLiteral('\n');
+        } else if (c == 't') {
+            ok = appendLiteral('\t');
+        } else if (c != 0 && strchr("aAbBCdeGgHIjmMpSuUVwWyYz", c) != NULL) {
+            ok = appendOp((uint8_t)c, NULL, 0);
+        } else {
+            // flags, width and modifier, then the conversion, or a lone % at the end
+            const char* end = spec;
+            while (*end && strchr("_-0^#+123456789EO", *end) != NULL) {
+                end++;
+            }
+            if (*end) {
+                end++;
+            }
+            ok = appendOp(LIBRARY, spec, end - spec < 16 ? end - spec : 16);
+            spec = end;
+            if (!ok) {
+                return false;
+            }
+            continue;
+        }
+        if (!ok) {
+            return false;
+        }
+        spec++;
+    }
+    return true;
+}
+
+TimeFormat::TimeFormat(const char* spec)
+{
+    set(spec);
+}
+
+bool TimeFormat::set(const char* spec)
+{
+    length = 0;
+    literalStart = -1;
+    if (spec == NULL || !strcmp(spec, TIME_FORMAT_DEFAULT)) {
+        spec = "%a %b %e %H:%M:%S %Y";  // as asctime() without the newline
+    }
+    complete = compile(spec, true);
+    if (!complete) {
+        // a composite such as %c takes one LIBRARY operation instead of up to 25 bytes
+        length = 0;
+        literalStart = -1;
+        complete = compile(spec, false);
+    }
+    if (!complete) {
+        length = 0;  // rather than a part of the format that looks right
+    }
+    return complete;
+}
+
+/*============================================================================*/
+/* formatting */
+
+namespace {
+
+// writes as much as fits into the buffer, always terminated, and counts the full length
+struct Output {
+    char* buf;
+    size_t size;
+    size_t length;
+
+    void put(char c)
+    {
+        if (length + 1 < size) {
+            buf[length] = c;
+        }
+        length++;
+    }
+
+    void put(const char* s, size_t n)
+    {
+        while (n--) {
+            put(*s++);
+        }
+    }
+
+    void put(const char* s)
+    {
+        while (*s) {
+            put(*s++);
+        }
+    }
+
+    // a number with at least width digits, padded with pad
+    void number(unsigned long value, int width, char pad = '0')
+    {
+        char digits[12];
+        int n = 0;
+        do {
+            digits[n++] = (char)('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        while (width-- > n) {
+            put(pad);
+        }
+        while (n--) {
+            put(digits[n]);
+        }
+    }
+
+    void finish()
+    {
+        if (size != 0) {
+            buf[length < size ? length : size - 1] = 0;
+        }
+    }
+};
+
+}
+
+size_t TimeFormat::formatTo(char* buf, size_t size, time_t local, long offset) const
+{
+    return render(buf, size, local, offset, NULL);
+}
+
+size_t TimeFormat::formatTo(char* buf, size_t size, const DateTime& t) const
+{
+    tm tme = {};
+    tme.tm_sec = t.second();
+    tme.tm_min = t.minute();
+    tme.tm_hour = t.hour();
+    tme.tm_mday = t.day();
+    tme.tm_mon = t.month();
+    tme.tm_year = CalendarYrToTm(t.year());
+    tme.tm_wday = t.weekday();
+    return render(buf, size, tme, t.localTime(), t.offset(), NULL);
+}
+
+size_t TimeFormat::render(char* buf, size_t size, time_t local, long offset, TimeStamper* stamper) const
+{
+    tm tme;
+    TimeClass::timeElements(local, tme);
+    return render(buf, size, tme, local, offset, stamper);
+}
+
+// format the elements of local, telling the stamper where each operation starts in the output
+size_t TimeFormat::render(char* buf, size_t size, const tm& tme, time_t local, long offset, TimeStamper* stamper) const
+{
+    Output out = { buf, size, 0 };
+    long year = tme.tm_year + 1970L;
+    int month = tme.tm_mon - 1;         // from 0
+    int wday = tme.tm_wday - 1;         // from 0 for Sunday
+    int hour12 = tme.tm_hour % 12 == 0 ? 12 : tme.tm_hour % 12;
+    static const uint16_t daysBefore[] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+    int yday = daysBefore[month] + tme.tm_mday - 1 + (month > 1 && isLeapYear(year));
+
+    for (size_t pc = 0; pc < length; ) {
+        uint8_t op = code[pc++];
+        if (stamper != NULL) {
+            stamper->addField(op, out.length);
+        }
+        switch (op) {
+            case LITERAL:
+                out.put((const char*)&code[pc + 1], code[pc]);
+                pc += 1 + code[pc];
+                break;
+            case 'a': out.put(weekdayNames[wday], 3); break;
+            case 'A': out.put(weekdayNames[wday]); break;
+            case 'b': out.put(monthNames[month], 3); break;
+            case 'B': out.put(monthNames[month]); break;
+            case 'C': out.number(year / 100, 2); break;
+            case 'd': out.number(tme.tm_mday, 2); break;
+            case 'e': out.number(tme.tm_mday, 2, ' '); break;
+            case 'H': out.number(tme.tm_hour, 2); break;
+            case 'I': out.number(hour12, 2); break;
+            case 'j': out.number(yday + 1, 3); break;
+            case 'm': out.number(month + 1, 2); break;
+            case 'M': out.number(tme.tm_min, 2); break;
+            case 'p': out.put(tme.tm_hour < 12 ? "AM" : "PM"); break;
+            case 'S': out.number(tme.tm_sec, 2); break;
+            case 'u': out.number(wday == 0 ? 7 : wday, 1); break;
+            case 'U': out.number((yday + 7 - wday) / 7, 2); break;
+            case 'w': out.number(wday, 1); break;
+            case 'W': out.number((yday + 7 - (wday + 6) % 7) / 7, 2); break;
+            case 'y': out.number(year % 100, 2); break;
+            case 'Y': out.number(year, 1); break;
+            case 'G':
+            case 'g':
+            case 'V': {
+                calendarDate_t date = makeDate(year, tme.tm_mon, tme.tm_mday);
+                if (op == 'G') {
+                    out.number(isoWeekYear(date), 1);
+                } else if (op == 'g') {
+                    out.number(isoWeekYear(date) % 100, 2);
+                } else {
+                    out.number(isoWeek(date), 2);
+                }
+                break;
+            }
+            case 'z':
+                // "Z" for UTC, otherwise the hours with a sign and the minutes
+                if (offset == 0) {
+                    out.put('Z');
+                } else {
+                    // the sign of the offset, so -1800 is "-00:30" as DateTime writes it
+                    unsigned long distance = offset < 0 ? -offset : offset;
+                    out.put(offset < 0 ? '-' : '+');
+                    out.number(distance / 3600, 2);
+                    out.put(':');
+                    out.number(distance / 60 % 60, 2);
+                }
+                break;
+            case LIBRARY: {
+                char spec[18] = "%";
+                memcpy(spec + 1, &code[pc + 1], code[pc]);
+                spec[1 + code[pc]] = 0;
+                pc += 1 + code[pc];
+                struct tm calendar_time = {};
+                gmtime_r(&local, &calendar_time);
+                char text[64];
+                size_t n = strftime(text, sizeof(text), spec, &calendar_time);
+                out.put(text, n);
+                break;
+            }
+        }
+    }
+    out.finish();
+    return out.length;
+}
+
+/*============================================================================*/
+/* stamping */
+
+TimeStamper::TimeStamper(const char* spec)
+  : format(spec), textLength(0), valid(false)
+{
+    text[0] = 0;
+}
+
+bool TimeStamper::set(const char* spec)
+{
+    valid = false;
+    return format.set(spec);
+}
+
+// called by TimeFormat::render() for each operation, only the time of day fields can be patched
+void TimeStamper::addField(uint8_t op, size_t position)
+{
+    if (op == 'H' || op == 'I' || op == 'M' || op == 'S' || op == 'p') {
+        if (fieldCount < TIME_STAMP_FIELDS && position + 2 < sizeof(text)) {
+            fieldOp[fieldCount] = op;
+            fieldPos[fieldCount] = (uint8_t)position;
+            fieldCount++;
+        } else {
+            patchable = false;
+        }
+    } else if (op == LIBRARY) {
+        patchable = false;  // strftime() may depend on anything
+    }
+}
+
+static inline void putPair(char* p, uint32_t value)
+{
+    p[0] = (char)('0' + value / 10);
+    p[1] = (char)('0' + value % 10);
+}
+
+const char* TimeStamper::stamp(time_t t)
+{
+    long offset = TimeClass::timeZone().offset(t);
+    uint32_t local = (uint32_t)(t + offset);
+    uint32_t day = local / 86400;
+    uint32_t second = local % 86400;
+    if (valid && patchable && day == lastDay && offset == lastOffset) {
+        if (second == lastSecond) {
+            return text;
+        }
+        // rewrite the fields that changed, the seconds nearly always and the rest once a minute
+        bool minuteChanged = (second / 60 != lastSecond / 60);
+        bool hourChanged = (second / 3600 != lastSecond / 3600);
+        for (uint8_t i = 0; i < fieldCount; i++) {
+            char* p = &text[fieldPos[i]];
+            switch (fieldOp[i]) {
+                case 'S':
+                    putPair(p, second % 60);
+                    break;
+                case 'M':
+                    if (minuteChanged) {
+                        putPair(p, second / 60 % 60);
+                    }
+                    break;
+                case 'H':
+                    if (hourChanged) {
+                        putPair(p, second / 3600);
+                    }
+                    break;
+                case 'I':
+                    if (hourChanged) {
+                        putPair(p, (second / 3600 + 11) % 12 + 1);
+                    }
+                    break;
+                case 'p':
+                    if (hourChanged) {
+                        p[0] = second < 43200 ? 'A' : 'P';
+                    }
+                    break;
+            }
+        }
+        lastSecond = second;
+        return text;
+    }
+
+    // a new day or zone offset, render everything and note where the fields are
+    fieldCount = 0;
+    patchable = true;
+    textLength = format.render(text, sizeof(text), (time_t)local, offset, this);
+    if (textLength >= sizeof(text)) {
+        patchable = false;  // cut, keep the length of the whole output as formatTo() does
+    }
+    valid = true;
+    lastDay = day;
+    lastOffset = offset;
+    lastSecond = second;
+    return text;
+}
+
+size_t TimeStamper::stampTo(char* buf, size_t size, time_t t)
+{
+    stamp(t);
+    if (size != 0) {
+        size_t n = textLength < size ? textLength : size - 1;
+        if (n > sizeof(text) - 1) {
+            n = sizeof(text) - 1;
+        }
+        memcpy(buf, text, n);
+        buf[n] = 0;
+    }
+    return textLength;
+}
@@ -34,6 +34,7 @@
 #define _Time_h
 
 #include <inttypes.h>
+#include <stddef.h>
 #ifndef __AVR__
 #include <sys/types.h> // for __time_t_defined, but avr libc lacks sys/types.h
 #include <sys/time.h>
@@ -55,20 +56,58 @@ typedef unsigned long time_t;
 // but at least this hack lets us define C++ functions as intended.  Hopefully
 // nothing too terrible will result from overriding the C library header?!
 extern "C++" {
-typedef enum {timeNotSet, timeNeedsSync, timeSet
+typedef enum {timeNotSet, timeNeedsSync, timeSet, timeEstimated
 }  timeStatus_t ;
 
+// progress of an asynchronous sync, see setSyncRequest()
+typedef enum {syncIdle, syncPending, syncBackoff
+}  syncStatus_t ;
+
 
 extern const char* TIME_FORMAT_DEFAULT;
 extern const char* TIME_FORMAT_ISO8601_FULL;
 
-//convenience macros to convert to and from tm years 
-#define  tmYearToCalendar(Y) ((Y) + 1970)  // full four digit year 
-#define  CalendarYrToTm(Y)   ((Y) - 1970)
-#define  tmYearToY2k(Y)      ((Y) - 30)    // offset is from 2000
-#define  y2kYearToTm(Y)      ((Y) + 30)   
+// convert to and from tm years, which count from 1970
+constexpr int tmYearToCalendar(int y) { return y + 1970; }  // full four digit year
+constexpr int CalendarYrToTm(int y)   { return y - 1970; }
+constexpr int tmYearToY2k(int y)      { return y - 30; }    // offset is from 2000
+constexpr int y2kYearToTm(int y)      { return y + 30; }
+
+typedef int64_t time_ms_t;  // milliseconds since Jan 1 1970
 
 typedef time_t(*getExternalTime)();
+typedef time_ms_t(*getExternalTimeMs)();  // a provider that also gives the fraction of the second
+typedef void(*requestExternalTime)();  // starts getting the time, the result is given to syncComplete()
+typedef uint64_t(*getTickCount)();  // a free running 64 bit counter that drives the clock
+
+// an answer from a time source, see addSyncSource()
+typedef struct {
+    time_ms_t time;         // the source's time when it answered, in milliseconds since Jan 1 1970
+    uint32_t  roundTrip;    // milliseconds from asking to getting the answer, 0 for a local source such as an RTC
+    uint32_t  uncertainty;  // milliseconds the time may be off either way, 500 for whole seconds given as t * 1000 + 500
+} timeSample_t;
+typedef bool(*getTimeSample)(timeSample_t& sample);  // fills in the sample, false if the source has no time now
+#define TIME_SYNC_SOURCES 4
+
+// the clock state kept by the snapshot storage across resets, see setSnapshotStorage()
+// plain bytes without padding, it can be written to EEPROM or flash as it is
+typedef struct {
+    uint32_t  version;        // TIME_SNAPSHOT_VERSION, a snapshot of another layout is not restored
+    uint32_t  uncertaintyMs;  // milliseconds the clock may have been off at the last sync
+    time_ms_t time;           // the clock when the snapshot was taken
+    uint32_t  syncAge;        // seconds from the last sync (or setting the time) to the snapshot
+    int32_t   driftPpb;       // as clockDriftPpb()
+    uint8_t   driftSamples;   // the syncs the drift was measured from, 0 if it was not measured
+    uint8_t   status;         // the timeStatus_t when it was taken
+    uint16_t  reserved;
+    uint32_t  check;          // of the bytes before it, a torn or erased snapshot does not match
+} timeSnapshot_t;
+typedef bool(*saveTimeSnapshot)(const timeSnapshot_t& snapshot);  // write to storage that survives a reset
+typedef bool(*loadTimeSnapshot)(timeSnapshot_t& snapshot);        // read it back, false if there is none
+#define TIME_SNAPSHOT_VERSION 1
+#ifndef TIME_DRIFT_BOUND_PPM
+#define TIME_DRIFT_BOUND_PPM 100  // how fast the corrected clock is assumed to wander, for timeUncertaintyMs()
+#endif
 //typedef void  (*setExternalTime)(const time_t); // not used in this version
 
 
@@ -82,30 +121,641 @@ typedef time_t(*getExternalTime)();
 #define SECS_PER_YEAR ((time_t)(SECS_PER_DAY * 365UL)) // TODO: ought to handle leap years
 #define SECS_YR_2000  ((time_t)(946684800UL)) // the time at the start of y2k
  
-/* Useful Macros for getting elapsed time */
-#define numberOfSeconds(_time_) ((_time_) % SECS_PER_MIN)  
-#define numberOfMinutes(_time_) (((_time_) / SECS_PER_MIN) % SECS_PER_MIN) 
-#define numberOfHours(_time_) (((_time_) % SECS_PER_DAY) / SECS_PER_HOUR)
-#define dayOfWeek(_time_) ((((_time_) / SECS_PER_DAY + 4)  % DAYS_PER_WEEK)+1) // 1 = Sunday
-#define elapsedDays(_time_) ((_time_) / SECS_PER_DAY)  // this is number of days since Jan 1 1970
-#define elapsedSecsToday(_time_) ((_time_) % SECS_PER_DAY)   // the number of seconds since last midnight 
-// The following macros are used in calculating alarms and assume the clock is set to a date later than Jan 1 1971
+/* Useful functions for getting elapsed time */
+constexpr time_t numberOfSeconds(time_t t) { return t % SECS_PER_MIN; }
+constexpr time_t numberOfMinutes(time_t t) { return (t / SECS_PER_MIN) % SECS_PER_MIN; }
+constexpr time_t numberOfHours(time_t t)   { return (t % SECS_PER_DAY) / SECS_PER_HOUR; }
+constexpr time_t dayOfWeek(time_t t)       { return ((t / SECS_PER_DAY + 4) % DAYS_PER_WEEK) + 1; } // 1 = Sunday
+constexpr time_t elapsedDays(time_t t)     { return t / SECS_PER_DAY; }  // this is number of days since Jan 1 1970
+constexpr time_t elapsedSecsToday(time_t t) { return t % SECS_PER_DAY; }  // the number of seconds since last midnight
+// The following functions are used in calculating alarms and assume the clock is set to a date later than Jan 1 1971
 // Always set the correct time before setting alarms
-#define previousMidnight(_time_) (((_time_) / SECS_PER_DAY) * SECS_PER_DAY)  // time at the start of the given day
-#define nextMidnight(_time_) (previousMidnight(_time_)  + SECS_PER_DAY)   // time at the end of the given day 
-#define elapsedSecsThisWeek(_time_) (elapsedSecsToday(_time_) +  ((dayOfWeek(_time_)-1) * SECS_PER_DAY))   // note that week starts on day 1
-#define previousSunday(_time_) ((_time_) - elapsedSecsThisWeek(_time_))      // time at the start of the week for the given time
-#define nextSunday(_time_) (previousSunday(_time_)+SECS_PER_WEEK)          // time at the end of the week for the given time
+constexpr time_t previousMidnight(time_t t) { return (t / SECS_PER_DAY) * SECS_PER_DAY; }  // time at the start of the given day
+constexpr time_t nextMidnight(time_t t)     { return previousMidnight(t) + SECS_PER_DAY; }  // time at the end of the given day
+constexpr time_t elapsedSecsThisWeek(time_t t) { return elapsedSecsToday(t) + (dayOfWeek(t) - 1) * SECS_PER_DAY; }  // note that week starts on day 1
+constexpr time_t previousSunday(time_t t)   { return t - elapsedSecsThisWeek(t); }  // time at the start of the week for the given time
+constexpr time_t nextSunday(time_t t)       { return previousSunday(t) + SECS_PER_WEEK; }  // time at the end of the week for the given time
+
+/* Useful functions for converting elapsed time to a time_t */
+constexpr time_t minutesToTime_t(long m) { return (time_t)m * SECS_PER_MIN; }
+constexpr time_t hoursToTime_t(long h)   { return (time_t)h * SECS_PER_HOUR; }
+constexpr time_t daysToTime_t(long d)    { return (time_t)d * SECS_PER_DAY; }
+constexpr time_t weeksToTime_t(long w)   { return (time_t)w * SECS_PER_WEEK; }
 
+/*==============================================================================*/
+/* Calendar functions that can be evaluated by the compiler, for example in static_assert() or to
+   get the time of the build with no work at startup. Years are full four digit years and months
+   and days count from 1; the elements must be valid, they are not normalized as makeTime() does. */
+
+constexpr bool isLeapYear(long year) {
+  return (year % 4 == 0) && (year % 100 != 0 || year % 400 == 0);
+}
+
+constexpr int daysInMonth(long year, int month) {
+  return month == 2 ? (isLeapYear(year) ? 29 : 28) : (month == 4 || month == 6 || month == 9 || month == 11) ? 30 : 31;
+}
+
+// days since Jan 1 1970, counting years from March 1st so the leap day is the last day of the year
+constexpr long daysFromCivilYear(long year, long dayOfYear) {  // year starting in March, dayOfYear from March 1st
+  return (year >= 0 ? year : year - 399) / 400 * 146097
+       + (year - (year >= 0 ? year : year - 399) / 400 * 400) * 365
+       + (year - (year >= 0 ? year : year - 399) / 400 * 400) / 4
+       - (year - (year >= 0 ? year : year - 399) / 400 * 400) / 100
+       + dayOfYear - 719468;
+}
+
+constexpr long daysFromCivil(long year, int month, int day) {
+  return daysFromCivilYear(month <= 2 ? year - 1 : year, (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1);
+}
+
+constexpr time_t calendarToTime(long year, int month, int day, int hour = 0, int minute = 0, int second = 0) {
+  return (time_t)daysFromCivil(year, month, day) * SECS_PER_DAY + hour * SECS_PER_HOUR + minute * SECS_PER_MIN + second;
+}
+
+// the date of a day since Jan 1 1970, inverse of daysFromCivil() for days from 1970 on
+constexpr long civilEra(long days)      { return (days + 719468) / 146097; }
+constexpr long civilDayOfEra(long days) { return days + 719468 - civilEra(days) * 146097; }  // [0, 146096]
+constexpr long civilYearOfEra(long days) {
+  return (civilDayOfEra(days) - civilDayOfEra(days) / 1460 + civilDayOfEra(days) / 36524 - civilDayOfEra(days) / 146096) / 365;
+}
+constexpr long civilDayOfYear(long days) {  // [0, 365], Mar 1 is 0
+  return civilDayOfEra(days) - (365 * civilYearOfEra(days) + civilYearOfEra(days) / 4 - civilYearOfEra(days) / 100);
+}
+constexpr long civilMonthIndex(long days) { return (5 * civilDayOfYear(days) + 2) / 153; }  // from March as 0
+constexpr long civilYear(long days)  { return civilEra(days) * 400 + civilYearOfEra(days) + (civilMonthIndex(days) >= 10); }
+constexpr int  civilMonth(long days) { return (int)(civilMonthIndex(days) < 10 ? civilMonthIndex(days) + 3 : civilMonthIndex(days) - 9); }
+constexpr int  civilDay(long days)   { return (int)(civilDayOfYear(days) - (153 * civilMonthIndex(days) + 2) / 5 + 1); }
+
+constexpr int timeYear(time_t t)  { return (int)civilYear(t / SECS_PER_DAY); }
+constexpr int timeMonth(time_t t) { return civilMonth(t / SECS_PER_DAY); }  // Jan is month 1
+constexpr int timeDay(time_t t)   { return civilDay(t / SECS_PER_DAY); }
+constexpr int timeWeekday(time_t t) { return (int)dayOfWeek(t); }  // Sunday is day 1
+constexpr int timeHour(time_t t)    { return (int)numberOfHours(t); }
+constexpr int timeMinute(time_t t)  { return (int)numberOfMinutes(t); }
+constexpr int timeSecond(time_t t)  { return (int)numberOfSeconds(t); }
+
+// month number of the three letter English abbreviation in __DATE__, 0 if it is none
+constexpr int monthOfAbbreviation(const char* m) {
+  return m[0] == 'J' ? (m[1] == 'a' ? 1 : (m[2] == 'n' ? 6 : 7)) :
+         m[0] == 'F' ? 2 :
+         m[0] == 'M' ? (m[2] == 'r' ? 3 : 5) :
+         m[0] == 'A' ? (m[1] == 'p' ? 4 : 8) :
+         m[0] == 'S' ? 9 :
+         m[0] == 'O' ? 10 :
+         m[0] == 'N' ? 11 :
+         m[0] == 'D' ? 12 : 0;
+}
+
+constexpr int twoDigits(const char* p) {
+  return ((p[0] >= '0' && p[0] <= '9') ? (p[0] - '0') * 10 : 0) + (p[1] - '0');  // the first may be a space
+}
 
-/* Useful Macros for converting elapsed time to a time_t */
-#define minutesToTime_t ((M)) ( (M) * SECS_PER_MIN)  
-#define hoursToTime_t   ((H)) ( (H) * SECS_PER_HOUR)  
-#define daysToTime_t    ((D)) ( (D) * SECS_PER_DAY) // fixed on Jul 22 2011
-#define weeksToTime_t   ((W)) ( (W) * SECS_PER_WEEK)   
+/**
+ * The time given by __DATE__ ("Mmm dd yyyy") and __TIME__ ("hh:mm:ss") as a time_t, so the time of
+ * the build costs nothing at startup:
+ *
+ *   constexpr time_t built = compileTime(__DATE__, __TIME__);
+ *
+ * The compiler gives local time, so the result is the local time of the build machine.
+ */
+constexpr time_t compileTime(const char* date, const char* time) {
+  return calendarToTime((date[7] - '0') * 1000 + (date[8] - '0') * 100 + twoDigits(date + 9),
+                        monthOfAbbreviation(date), twoDigits(date + 4),
+                        twoDigits(time), twoDigits(time + 3), twoDigits(time + 6));
+}
+
+/*==============================================================================*/
+/* Calendar arithmetic on dates, without time elements or the cache behind hour(), day() etc.
+   A calendarDate_t packs the year, month and day into one number that compares like the dates;
+   day numbers count days since Jan 1 1970 as daysFromCivil() does. Years from 0 are supported. */
+
+typedef uint32_t calendarDate_t;  // year << 9 | month << 5 | day
+
+constexpr calendarDate_t makeDate(long year, int month, int day) {
+  return ((calendarDate_t)year << 9) | ((calendarDate_t)month << 5) | (calendarDate_t)day;
+}
+constexpr long dateYear(calendarDate_t d) { return (long)(d >> 9); }
+constexpr int  dateMonth(calendarDate_t d) { return (int)((d >> 5) & 15); }  // Jan is month 1
+constexpr int  dateDay(calendarDate_t d)   { return (int)(d & 31); }
+
+constexpr long dateToDays(calendarDate_t d) { return daysFromCivil(dateYear(d), dateMonth(d), dateDay(d)); }
+constexpr calendarDate_t daysToDate(long days) { return makeDate(civilYear(days), civilMonth(days), civilDay(days)); }
+constexpr calendarDate_t dateOf(time_t t) { return daysToDate((long)(t / SECS_PER_DAY)); }
+constexpr time_t dateToTime(calendarDate_t d) { return (time_t)dateToDays(d) * SECS_PER_DAY; }  // its midnight
+
+constexpr calendarDate_t addDays(calendarDate_t d, long days) { return daysToDate(dateToDays(d) + days); }
+
+// the day is clamped to the length of the new month: Jan 31 plus a month is Feb 28 or 29
+constexpr calendarDate_t monthOfIndex(long monthIndex, int day) {  // monthIndex is year * 12 + month - 1
+  return makeDate(monthIndex / 12, (int)(monthIndex % 12) + 1,
+                  day < daysInMonth(monthIndex / 12, (int)(monthIndex % 12) + 1) ? day : daysInMonth(monthIndex / 12, (int)(monthIndex % 12) + 1));
+}
+constexpr long monthIndex(calendarDate_t d) { return dateYear(d) * 12 + dateMonth(d) - 1; }
+constexpr calendarDate_t addMonths(calendarDate_t d, long months) { return monthOfIndex(monthIndex(d) + months, dateDay(d)); }
+constexpr calendarDate_t addYears(calendarDate_t d, long years) { return addMonths(d, years * 12); }  // Feb 29 becomes Feb 28
+
+// whole units from a to b, negative if b is earlier; addMonths(a, monthsBetween(a, b)) never passes b
+constexpr long daysBetween(calendarDate_t a, calendarDate_t b) { return dateToDays(b) - dateToDays(a); }
+constexpr long monthsBetweenFrom(calendarDate_t a, calendarDate_t b, long months) {  // months counted without the days
+  return months > 0 && addMonths(a, months) > b ? months - 1 : (months < 0 && addMonths(a, months) < b ? months + 1 : months);
+}
+constexpr long monthsBetween(calendarDate_t a, calendarDate_t b) { return monthsBetweenFrom(a, b, monthIndex(b) - monthIndex(a)); }
+constexpr long yearsBetween(calendarDate_t a, calendarDate_t b) { return monthsBetween(a, b) / 12; }
+
+constexpr int dayOfYear(calendarDate_t d) { return (int)(dateToDays(d) - daysFromCivil(dateYear(d), 1, 1)) + 1; }  // Jan 1 is 1
+constexpr int dateWeekday(calendarDate_t d) { return (int)(((dateToDays(d) % 7) + 11) % 7) + 1; }  // Sunday is day 1, as weekday()
+constexpr int isoWeekday(calendarDate_t d) { return (int)(((dateToDays(d) % 7) + 10) % 7) + 1; }   // Monday is day 1
+
+// ISO 8601 weeks start on Monday and belong to the year of their Thursday, so Jan 1 can be in week 52 or 53
+constexpr long isoThursday(calendarDate_t d) { return dateToDays(d) - isoWeekday(d) + 4; }  // as a day number
+constexpr long isoWeekYear(calendarDate_t d) { return civilYear(isoThursday(d)); }
+constexpr int isoWeek(calendarDate_t d) { return (int)((isoThursday(d) - daysFromCivil(isoWeekYear(d), 1, 1)) / 7) + 1; }
+
+/**
+ * The dates from first up to but not including end, one day at a time without converting day
+ * numbers: for (calendarDate_t d : DateRange(first, end)) { ... }
+ */
+class DateRange {
+public:
+    class iterator {
+    public:
+        explicit iterator(calendarDate_t d) : date(d) {}
+        calendarDate_t operator*() const { return date; }
+        bool operator!=(const iterator& other) const { return date < other.date; }  // ends at or after end
+        iterator& operator++() {
+            if (dateDay(date) < daysInMonth(dateYear(date), dateMonth(date))) {
+                date++;
+            } else if (dateMonth(date) < 12) {
+                date = makeDate(dateYear(date), dateMonth(date) + 1, 1);
+            } else {
+                date = makeDate(dateYear(date) + 1, 1, 1);
+            }
+            return *this;
+        }
+    private:
+        calendarDate_t date;
+    };
+
+    constexpr DateRange(calendarDate_t from, calendarDate_t until) : first(from), last(until) {}
+    iterator begin() const { return iterator(first); }
+    iterator end() const { return iterator(last); }
+    constexpr long days() const { return first < last ? daysBetween(first, last) : 0; }
+
+private:
+    calendarDate_t first, last;
+};
 
 #define dt_MAX_STRING_LEN 9 // length of longest date string (excluding terminating null)
 
+// columns of time elements used by the bulk conversion functions, one array per element
+typedef struct {
+    uint16_t* year;    // full four digit year: (2009, 2010 etc)
+    uint8_t*  month;   // Jan is month 1
+    uint8_t*  day;     // day of the month
+    uint8_t*  hour;
+    uint8_t*  minute;
+    uint8_t*  second;
+    uint8_t*  wday;    // Sunday is day 1, not read by makeTimeBatch()
+} tmColumns_t;
+
+// how the cached date has been updated, counted when the library is built with TIME_CACHE_STATS
+// only the functions that need the date use the cache, hour() and the other time of day functions do not
+typedef struct {
+    uint32_t hits;          // the date of the requested day was already cached
+    uint32_t incremental;   // the cached date was moved on to the next day
+    uint32_t full;          // the date was computed from the day count
+} cacheStats_t;
+
+// TIME_STATS counts what the clock does as well as the cache; without it the counts stay 0
+#if defined(TIME_STATS) && !defined(TIME_CACHE_STATS)
+#define TIME_CACHE_STATS
+#endif
+
+#define TIME_STATS_BUCKETS 16  // histogram buckets: under 1 ms, then [1, 2), [2, 4) ... and the last for the rest
+
+// what the clock has done since resetTimeStats(), counted when the library is built with TIME_STATS
+typedef struct {
+    cacheStats_t cache;
+    uint32_t nowCalls;           // clock updates by now(), nowMs() and the functions that call them
+    uint32_t catchUps;           // updates that counted more than one second, the clock was not read for a while
+    uint32_t catchUpSeconds;     // the seconds counted by those updates
+    uint32_t catchUpMax;         // the most seconds counted by one update
+    uint32_t syncs;              // provider calls and answered requests, including failures
+    uint32_t syncFailures;       // no time from the provider, or a request that failed or timed out
+    uint32_t syncLatency[TIME_STATS_BUCKETS];  // how long syncs took, in milliseconds
+    uint32_t syncLatencyMaxUs;
+    uint32_t steps;              // the clock was set to a different time, by a sync or by hand
+    uint32_t stepSize[TIME_STATS_BUCKETS];     // how far, in milliseconds either way
+    int32_t  lastStepMs;         // the last step, negative if the clock was set back
+    uint32_t slews;              // syncs that slewed a small offset away instead
+    uint32_t statusCalls;        // calls of timeStatus()
+    uint32_t statusMicros;       // the time spent in them
+    uint32_t statusMaxMicros;
+    long     driftPpb;           // as clockDriftPpb(), filled in by getTimeStats()
+    long     offsetMs;           // as clockOffsetMs()
+    uint8_t  driftSamples;       // the syncs the drift was measured from, up to 255
+} timeStats_t;
+
+// events passed to the trace handler, see setTimeTrace()
+typedef enum {timeTraceSync, timeTraceSyncFailed, timeTraceStep, timeTraceSlew
+}  timeTraceEvent_t ;
+
+// value is the latency in microseconds of a sync, or the step or slewed offset in milliseconds
+typedef void(*timeTraceHandler)(timeTraceEvent_t event, long value);
+
+class Print;  // of the Arduino core, see printTimeStats()
+
+// a month or day name, pointing into the locale table without a copy; on AVR the text is in program memory
+typedef struct {
+    const char* text;    // not always null terminated, use length
+    uint8_t     length;  // in bytes, a UTF-8 name may have more bytes than characters
+} dateName_t;
+
+// the names used by monthName(), dayName() and the other date strings, see setDateLocale()
+// on AVR the arrays and the strings they point to must be in PROGMEM, the structure itself in RAM
+typedef struct {
+    const char* const* months;       // 13 names, the name for an invalid month and then January to December
+    const char* const* monthsShort;  // 13 abbreviations in the same order
+    const char* const* days;         // 8 names, the name for an invalid day and then Sunday to Saturday
+    const char* const* daysShort;    // 8 abbreviations in the same order
+} dateLocale_t;
+
+extern const dateLocale_t DATE_LOCALE_ENGLISH;
+
+/**
+ * A time zone compiled from a POSIX TZ string such as "CET-1CEST,M3.5.0,M10.5.0/3": the standard
+ * name and offset (hours west of UTC, as POSIX has it), then optionally the daylight saving
+ * name, offset and the rules when it starts and ends. The transitions of the year in use are
+ * cached, so while a time stays between the same two transitions offset() is a single compare.
+ * The cache is safe to share between threads.
+ */
+class TimeZone {
+public:
+    TimeZone();                       // UTC
+    explicit TimeZone(const char* tz);  // UTC if tz is not understood
+
+    bool   set(const char* tz);       // false if tz is not understood, then the zone is unchanged
+    long   offset(time_t utc) const;  // seconds to add to utc to get the local time
+    bool   isDst(time_t utc) const;   // whether daylight saving time is in effect at utc
+    const char* name(time_t utc) const;  // the abbreviation in effect at utc, e.g. "CEST"
+    time_t toLocal(time_t utc) const { return utc + offset(utc); }
+    time_t toUtc(time_t local) const; // a repeated local time is taken as the first, a skipped one as standard time
+
+private:
+    // the day a transition happens, as Jn (day 1-365 without leap days), n (day 0-365) or Mm.w.d
+    struct Rule {
+        uint8_t  kind;   // 'J', 'D' or 'M'
+        uint8_t  month;  // 1-12
+        uint8_t  week;   // 1-5, 5 is the last week
+        uint8_t  wday;   // 0-6, Sunday is 0
+        uint16_t day;
+        long     time;   // seconds after local midnight the transition happens
+    };
+
+    long    stdOffset;  // seconds east of UTC
+    long    dstOffset;
+    bool    hasDst;
+    Rule    dstStart, dstEnd;
+    char    stdName[8], dstName[8];
+
+    // cache, a seqlock like the one of the time elements
+    mutable uint32_t seq;
+    mutable uint32_t from, until;     // offset() is cachedOffset from..until-1
+    mutable long     cachedOffset;
+    mutable uint32_t yearFrom, yearUntil, yearCuts[2];  // the UTC year from..until-1, cut at its transitions
+    mutable uint32_t yearDst;                          // bit i is set if period i of the year is daylight saving time
+
+    int64_t  transition(const Rule& rule, long year, long wallOffset) const;
+    long     lookup(uint32_t utc) const;
+};
+
+/**
+ * A strftime() format compiled once into a list of operations. formatTo() writes into the
+ * caller's buffer without heap allocation and gives the same output as strftime() in the C
+ * locale, with %z as "Z" for UTC and "+hh:mm" otherwise. Literal text takes one byte per
+ * character. If the format does not fit in TIME_FORMAT_CODE_SIZE bytes, composite conversions
+ * such as %c are left to strftime(); if it still does not fit, set() returns false, the format
+ * writes nothing and isComplete() is false.
+ */
+#define TIME_FORMAT_CODE_SIZE 96
+
+class TimeStamper;
+class DateTime;
+
+class TimeFormat {
+public:
+    TimeFormat(const char* spec = TIME_FORMAT_DEFAULT);
+    bool   set(const char* spec);  // false if the format does not fit, it then writes nothing
+    bool   isComplete() const { return complete; }
+
+    // format the local time, offset seconds east of UTC, as snprintf() does: the output is cut to
+    // fit size - 1 characters and terminated, the length of the whole output is returned
+    size_t formatTo(char* buf, size_t size, time_t local, long offset) const;
+    size_t formatTo(char* buf, size_t size, const DateTime& t) const;  // with the elements it holds
+
+private:
+    uint8_t code[TIME_FORMAT_CODE_SIZE];
+    uint8_t length;
+    bool    complete;      // the whole format was compiled
+    int16_t literalStart;  // the literal being extended while compiling, -1 if none
+
+    bool   compile(const char* spec, bool expand);
+    bool   appendLiteral(char c);
+    bool   appendOp(uint8_t op, const char* directive, size_t n);
+    size_t render(char* buf, size_t size, time_t local, long offset, TimeStamper* stamper) const;
+    size_t render(char* buf, size_t size, const tm& tme, time_t local, long offset, TimeStamper* stamper) const;
+
+    friend class TimeStamper;
+};
+
+/**
+ * Timestamps for a stream of increasing times, such as log lines, with one format. The last
+ * text is kept, and while the day and the zone offset stay the same only the hour, minute and
+ * second digits that changed are rewritten. A new day or offset renders the text again.
+ * Formats with conversions left to strftime() are always rendered completely, and the text is
+ * cut to TIME_STAMP_SIZE - 1 characters. A stamper is not shared between threads.
+ */
+#define TIME_STAMP_SIZE 64
+#define TIME_STAMP_FIELDS 8
+
+class TimeStamper {
+public:
+    TimeStamper(const char* spec = TIME_FORMAT_ISO8601_FULL);
+    bool   set(const char* spec);  // false if the format does not fit, as TimeFormat::set()
+
+    const char* stamp(time_t t);  // the text for t in the time zone, valid until the next call
+    size_t stampTo(char* buf, size_t size, time_t t);  // copy it into buf, returns the length as formatTo()
+    size_t length() const { return textLength; }     // of the last text
+
+private:
+    TimeFormat format;
+    char     text[TIME_STAMP_SIZE];
+    size_t   textLength;
+    bool     valid;       // text is the time lastDay, lastSecond
+    bool     patchable;   // all the time of day fields are known and fit in text
+    uint32_t lastDay, lastSecond;
+    long     lastOffset;
+    uint8_t  fieldCount;
+    uint8_t  fieldOp[TIME_STAMP_FIELDS];   // H, I, M, S or p
+    uint8_t  fieldPos[TIME_STAMP_FIELDS];  // where the field starts in text
+
+    void   addField(uint8_t op, size_t position);
+
+    friend class TimeFormat;
+};
+
+/**
+ * A time with its zone offset and all its elements, computed once when it is made and stored in
+ * the value, so reading several elements does not go through the shared cache and a DateTime
+ * can be passed around and copied freely, also between threads. A DateTime never changes:
+ * arithmetic returns a new one. Comparisons are by the instant, whatever the offsets.
+ * Local times before 1970 are not supported.
+ *
+ * The arithmetic keeps the offset. Adding days gives the same wall clock time on a later day at
+ * that offset, so across a change of daylight saving time use inZone() to take the zone's offset
+ * at the new time.
+ */
+#define DATE_TIME_ISO_SIZE 26  // "2023-11-14T23:13:20+01:00" and the terminating 0
+
+class DateTime {
+public:
+    constexpr DateTime() : DateTime(0, 0) {}
+    constexpr explicit DateTime(time_t t, long offset = 0)  // t as seen offset seconds east of UTC
+      : utc(t), zoneOffset((int32_t)offset),
+        yr((uint16_t)timeYear(t + offset)), mon((uint8_t)timeMonth(t + offset)), mday((uint8_t)timeDay(t + offset)),
+        hr((uint8_t)timeHour(t + offset)), mins((uint8_t)timeMinute(t + offset)), secs((uint8_t)timeSecond(t + offset)),
+        wday((uint8_t)timeWeekday(t + offset)) {}
+    DateTime(time_t t, const TimeZone& zone) : DateTime(t, zone.offset(t)) {}
+
+    static DateTime now();  // in the time zone set by setTimeZone()
+    static constexpr DateTime fromLocal(int year, int month, int day, int hour = 0, int minute = 0, int second = 0, long offset = 0) {
+        return DateTime(calendarToTime(year, month, day, hour, minute, second) - offset, offset);
+    }
+    static DateTime fromLocal(int year, int month, int day, int hour, int minute, int second, const TimeZone& zone);
+
+    constexpr time_t time() const { return utc; }
+    constexpr time_t localTime() const { return utc + zoneOffset; }
+    constexpr long offset() const { return zoneOffset; }  // seconds east of UTC
+    constexpr int year() const { return yr; }
+    constexpr int month() const { return mon; }     // Jan is month 1
+    constexpr int day() const { return mday; }
+    constexpr int hour() const { return hr; }
+    constexpr int minute() const { return mins; }
+    constexpr int second() const { return secs; }
+    constexpr int weekday() const { return wday; }  // Sunday is day 1
+    constexpr int hourFormat12() const { return hr % 12 == 0 ? 12 : hr % 12; }
+    constexpr bool isPM() const { return hr >= 12; }
+    constexpr calendarDate_t date() const { return makeDate(yr, mon, mday); }
+    constexpr long secondOfDay() const { return hr * 3600L + mins * 60L + secs; }
+
+    constexpr DateTime withOffset(long offset) const { return DateTime(utc, offset); }  // the same instant
+    DateTime inZone(const TimeZone& zone) const { return DateTime(utc, zone); }
+    constexpr DateTime addSeconds(long seconds) const { return DateTime(utc + seconds, zoneOffset); }
+    constexpr DateTime addDays(long days) const { return DateTime(utc + days * SECS_PER_DAY, zoneOffset); }
+    constexpr DateTime addMonths(long months) const {  // the last day of a shorter month if the day is not in it
+        return DateTime(dateToTime(::addMonths(date(), months)) + secondOfDay() - zoneOffset, zoneOffset);
+    }
+    constexpr DateTime addYears(long years) const { return addMonths(years * 12); }
+
+    constexpr DateTime operator+(long seconds) const { return addSeconds(seconds); }
+    constexpr DateTime operator-(long seconds) const { return addSeconds(-seconds); }
+    constexpr long operator-(const DateTime& other) const { return (long)(utc - other.utc); }  // seconds between
+    constexpr bool operator==(const DateTime& other) const { return utc == other.utc; }
+    constexpr bool operator!=(const DateTime& other) const { return utc != other.utc; }
+    constexpr bool operator<(const DateTime& other) const { return utc < other.utc; }
+    constexpr bool operator<=(const DateTime& other) const { return utc <= other.utc; }
+    constexpr bool operator>(const DateTime& other) const { return utc > other.utc; }
+    constexpr bool operator>=(const DateTime& other) const { return utc >= other.utc; }
+
+    // write into buf as snprintf() does, returning the length of the whole output; the first one
+    // writes ISO 8601 with the offset, "Z" at UTC, without going through a TimeFormat
+    size_t formatTo(char* buf, size_t size) const;
+    size_t formatTo(char* buf, size_t size, const TimeFormat& format) const;
+
+private:
+    time_t   utc;
+    int32_t  zoneOffset;
+    uint16_t yr;    // the elements of the local time utc + zoneOffset
+    uint8_t  mon, mday, hr, mins, secs, wday;
+};
+
+typedef void(*alarmHandler)(void* context);  // called by TimeWheel::service() when an alarm is due
+
+// one alarm, owned by the application and scheduled on a TimeWheel; it must outlive its scheduling
+class TimeAlarm {
+public:
+    TimeAlarm() : next(NULL), pprev(NULL) {}
+
+    bool   isScheduled() const { return pprev != NULL; }
+    time_t time() const { return (time_t)when; }  // when it is due next, if scheduled
+
+private:
+    TimeAlarm*  next;
+    TimeAlarm** pprev;    // the pointer to this alarm in its list, NULL when not scheduled
+    uint32_t    when;
+    uint32_t    period;   // seconds between repeats, 0 for a single alarm
+    bool        elapsed;  // due after a duration rather than at a time of the clock
+    int8_t      level;    // the wheel level it is in, -1 for the lists outside the levels
+    alarmHandler handler;
+    void*       context;
+
+    friend class TimeWheel;
+};
+
+/**
+ * Alarms driven by now(), kept in a hierarchical timing wheel with a level for the seconds,
+ * minutes and hours of the current day and one for the next 32 days; later alarms wait in a
+ * list that is looked at every 32 days. Scheduling and cancelling are O(1), and service() only
+ * visits the alarms that are due and those moving down a level, skipping empty stretches.
+ *
+ * Steps of the clock by setTime(), adjustTime() or a sync are handled by the next call:
+ * - alarms at a time (at(), repeat()) stay at that time. A step forward fires the ones it jumped
+ *   over once, a step back does not fire anything again.
+ * - alarms after a duration (after(), every()) move with the step, so they still wait as long.
+ * Alarms that repeat fire once however many periods were missed, and continue from the next one.
+ * Handlers may schedule and cancel any alarm. A wheel is not shared between threads.
+ */
+#define TIME_WHEEL_DAYS 32
+
+class TimeWheel {
+public:
+    TimeWheel();
+
+    void at(TimeAlarm& alarm, time_t t, alarmHandler handler, void* context = NULL);  // once at t
+    void repeat(TimeAlarm& alarm, time_t first, uint32_t period, alarmHandler handler, void* context = NULL);
+    void after(TimeAlarm& alarm, uint32_t seconds, alarmHandler handler, void* context = NULL);  // once
+    void every(TimeAlarm& alarm, uint32_t period, alarmHandler handler, void* context = NULL);   // first after period
+    void cancel(TimeAlarm& alarm);
+
+    uint16_t service();  // call from loop(): fires the alarms that are due, returns how many
+    uint16_t count() const { return scheduled; }
+
+private:
+    TimeAlarm* seconds[60];
+    TimeAlarm* minutes[60];
+    TimeAlarm* hours[24];
+    TimeAlarm* days[TIME_WHEEL_DAYS];
+    TimeAlarm* later;          // more than TIME_WHEEL_DAYS days ahead
+    TimeAlarm* due;            // at or before current, fired by the next service()
+    TimeAlarm* firing;         // the alarms service() is firing
+    uint16_t   levelCount[4];  // alarms in seconds, minutes, hours and days
+    uint16_t   scheduled;
+    uint32_t   current;        // the second the wheel has reached
+    uint32_t   steps;          // TimeClass::steppedSeconds() when the wheel last looked
+    bool       started;
+
+    void     start();
+    void     schedule(TimeAlarm& alarm, uint32_t when, uint32_t period, bool elapsed, alarmHandler handler, void* context);
+    void     place(TimeAlarm& alarm);
+    void     unlink(TimeAlarm& alarm);
+    void     redistribute(TimeAlarm*& list);
+    uint16_t fire(TimeAlarm*& list, int8_t level, uint32_t horizon);
+    void     gather(TimeAlarm*& list, TimeAlarm*& chain);
+    void     followSteps();
+};
+
+/**
+ * A cron expression compiled into one bitset per field: "minute hour day month weekday", or with
+ * a seconds field first. Fields take *, numbers, ranges a-b, steps as a-b/n or a star and /n,
+ * lists joined by commas, and the names JAN-DEC and SUN-SAT; weekday 7 is Sunday too. The day of the month may
+ * be L for the last day, and a weekday may be given as MON#1 for the first Monday of the month or
+ * FRIL for the last Friday. As in cron, when both the day and the weekday are restricted a day
+ * matching either one matches. @yearly, @monthly, @weekly, @daily and @hourly are accepted too.
+ *
+ * next() finds the next matching time with bit scans: a month that does not match is skipped
+ * whole, the days of a month that match are one mask, and within a day the hour, minute and
+ * second are each a scan. Times are taken as they are, UTC or local; the TimeZone versions
+ * match the local time in the zone, firing once in a repeated hour when the clock goes back.
+ */
+class TimeCron {
+public:
+    TimeCron();  // matches nothing until set
+    explicit TimeCron(const char* spec);
+
+    bool   set(const char* spec);  // false if spec is not understood, then nothing matches
+    bool   isValid() const { return valid; }
+    bool   matches(time_t t) const;
+    time_t next(time_t after) const;  // the first matching time after `after`, 0 if there is none
+    time_t next(time_t after, const TimeZone& zone) const;
+
+    // the matching times from `from` up to but not including `until`, at most max of them;
+    // returns how many were written
+    size_t fireTimes(time_t from, time_t until, time_t* times, size_t max) const;
+    size_t fireTimes(time_t from, time_t until, time_t* times, size_t max, const TimeZone& zone) const;
+
+private:
+    uint64_t seconds;         // bit n for second n
+    uint64_t minutes;
+    uint32_t hours;
+    uint32_t days;            // bit n for day n of the month
+    uint16_t months;          // bit n for month n, Jan is 1
+    uint8_t  weekdays;        // bit n for weekday n, Sunday is 0
+    uint8_t  nthWeekday[7];   // bit n - 1 for the nth of the weekday in the month, bit 5 for the last
+    bool     lastDay;         // L in the day of the month
+    bool     anyDay;          // the day of the month is *, the weekday alone decides
+    bool     anyWeekday;      // the weekday is *, the day of the month alone decides
+    bool     valid;
+
+    bool     parse(const char* spec);
+    bool     parseField(const char*& p, uint8_t field, uint64_t& mask, bool& any);
+    uint32_t dayMask(long year, int month) const;
+    long     timeOfDay(uint32_t second) const;
+};
+
+/**
+ * Compact encoding of a stream of timestamps, for logs where each time is close to the time
+ * before. Each time is written as the change of its difference from the one before (delta of
+ * delta) in a zigzag varint, so a regular series takes one byte per time. Every keyframeInterval
+ * times, and for the first one, the whole time is written instead so decoding can start there.
+ * Times are kept in seconds, or in milliseconds if the encoder is made with milliseconds set.
+ *
+ * A keyframe is a 0 byte followed by the varint of time << 1 | milliseconds; any other record
+ * is the varint of the zigzag delta of delta plus 1, and so never starts with a 0 byte.
+ */
+#define TIME_CODEC_KEYFRAME 64
+#define TIME_CODEC_MAX_RECORD 11  // bytes of the longest record, a keyframe
+
+class TimeEncoder {
+public:
+    TimeEncoder(bool milliseconds = false, uint16_t keyframeInterval = TIME_CODEC_KEYFRAME);
+    void   reset();  // the next time is written as a keyframe
+
+    // write the record for the next time into buf, returns its length, 0 if it needs more than size
+    size_t encode(time_t t, uint8_t* buf, size_t size);
+    size_t encodeMs(time_ms_t t, uint8_t* buf, size_t size);  // the milliseconds are dropped unless kept
+
+private:
+    int64_t  previous;       // the last time in the units of the stream
+    int64_t  previousDelta;
+    uint16_t interval;
+    uint16_t sinceKeyframe;  // records since the last keyframe, interval to start with one
+    bool     milliseconds;
+};
+
+class TimeDecoder {
+public:
+    TimeDecoder(const uint8_t* data, size_t size);
+
+    bool   next(time_t& t);        // the next time, false at the end or if the data is damaged
+    bool   nextMs(time_ms_t& t);
+    size_t decode(time_t* times, size_t count);  // up to count times, returns how many
+    size_t decodeMs(time_ms_t* times, size_t count);
+
+    // go to the first time at or after t, starting from the last keyframe before it; the times
+    // must be increasing. False if there is none, the decoder is then at the end
+    bool   seekMs(time_ms_t t);
+    size_t position() const { return pos; }  // bytes read
+
+private:
+    const uint8_t* data;
+    size_t   size;
+    size_t   pos;
+    int64_t  previous;
+    int64_t  previousDelta;
+    bool     started;       // a keyframe has been read
+    bool     milliseconds;  // of the last keyframe
+};
+
 class TimeClass {
 public:
     TimeClass() {
@@ -135,27 +785,144 @@ public:
     static int     year(time_t t);    // the year for the given time
 
     static time_t now();              // return the current time as seconds since Jan 1 1970 
-    static void    setTime(time_t t);
+    static time_ms_t nowMs();         // return the current time as milliseconds since Jan 1 1970
+    static void    setTime(time_t t); // the clock starts at the beginning of second t
     static void    setTime(int hr,int min,int sec,int day, int month, int yr);
-    static void    adjustTime(long adjustment);
+    static void    setTimeMs(time_ms_t t); // set the time including the fraction of the second
+    static void    adjustTime(long adjustment); // add seconds, the fraction of the second is kept
+    static void    adjustTimeMs(long adjustment); // add milliseconds
 
     /* date strings */ 
-    static char* monthStr(uint8_t month);
-    static char* dayStr(uint8_t day);
-    static char* monthShortStr(uint8_t month);
-    static char* dayShortStr(uint8_t day);
+    static const char* monthStr(uint8_t month);  // null terminated; on AVR copied into a buffer shared by these four
+    static const char* dayStr(uint8_t day);
+    static const char* monthShortStr(uint8_t month);
+    static const char* dayShortStr(uint8_t day);
+
+    /**
+     * Names from the current locale as views into its tables, without copying and safe to call
+     * from several threads. Month 1 is January and day 1 is Sunday, out of range values give the
+     * locale's invalid name.
+     */
+    static dateName_t monthName(uint8_t month);
+    static dateName_t monthShortName(uint8_t month);
+    static dateName_t dayName(uint8_t day);
+    static dateName_t dayShortName(uint8_t day);
+
+    /**
+     * Select the names returned by the functions above, NULL for English. The table is not
+     * copied and must stay valid. Set it before other threads look up names.
+     */
+    static void setDateLocale(const dateLocale_t* locale);
+    static const dateLocale_t* dateLocale();
+
+    /**
+     * The month (1-12) or day (1-7, Sunday is 1) with the full or abbreviated name in text, in
+     * the current locale and ignoring ASCII case; 0 if there is none. Looked up in a perfect hash
+     * table built for the locale.
+     */
+    static uint8_t monthFromName(const char* text, size_t length);
+    static uint8_t dayFromName(const char* text, size_t length);
       
     /* time sync functions	*/
     static timeStatus_t timeStatus(); // indicates if time has been set and recently synchronized
     static void    setSyncProvider( getExternalTime getTimeFunction); // identify the external time provider
+    static void    setSyncProviderMs( getExternalTimeMs getTimeFunction); // identify a provider of time in milliseconds
     static void    setSyncInterval(time_t interval); // set the number of seconds between re-sync
 
+    /**
+     * Several time sources, such as an RTC, a GPS and NTP, instead of a single provider. When a
+     * sync is due every source is asked for a sample. A sample gives a range the time is in: from
+     * its time minus its uncertainty to its time plus the round trip and the uncertainty, the
+     * round trip covering the delay of the answer. The quality of the source is added to the
+     * uncertainty of all its samples. Each source votes for its range with the weight of its
+     * priority, and the clock is disciplined to the range that has the most weight behind it
+     * (Marzullo's algorithm), so a source that disagrees with the others is outvoted instead of
+     * stepping the clock. Adding a source again changes its priority and quality, and
+     * setSyncProvider() and the other providers remove all sources.
+     */
+    static bool    addSyncSource(getTimeSample source, uint8_t priority = 1, uint32_t qualityMs = 0);  // false if there are TIME_SYNC_SOURCES
+    static uint8_t syncSourcesUsed();  // bit i is set when source i (in the order added) agreed with the last sync
+
+    /**
+     * Asynchronous sync. When a sync is due, now() calls `requestFunction` once and returns
+     * immediately. The application later delivers the time with syncComplete(), or reports
+     * a failure with syncFailed(). A request without an answer after `timeoutMs` counts as a
+     * failure. After a failure timeStatus() is timeNeedsSync (unless the time was never set)
+     * and the request is repeated after 1, 2, 4 ... seconds, up to the sync interval.
+     * These functions must be called from the same thread as now().
+     */
+    static void    setSyncRequest( requestExternalTime requestFunction, uint32_t timeoutMs = 1500);
+    static bool    syncComplete(time_t t);       // deliver the requested time, false if no request is pending
+    static bool    syncCompleteMs(time_ms_t t);  // as above with milliseconds
+    static void    syncFailed();                 // the pending request failed
+    static syncStatus_t syncStatus();            // idle, waiting for syncComplete(), or waiting to retry
+    static uint32_t syncFailures();              // consecutive failed requests
+    static void    setTickSource(getTickCount ticksFunction, uint32_t ticksPerSecond); // count time with this instead of millis()
+
+    /**
+     * Clock discipline. Each sync measures how far the clock is off, and the drift of the tick
+     * source is estimated from successive offsets and corrected continuously. Offsets up to
+     * the step threshold (128 ms by default) are slewed away by running the clock at most
+     * 500 ppm fast or slow; larger ones are stepped. A provider that gives whole seconds only
+     * corrects the clock when it is outside the second given.
+     */
+    static void    setStepThreshold(uint32_t ms);  // 0 to always step
+    static long    clockDriftPpb();               // parts per billion the tick source runs fast, negative if slow
+    static long    clockOffsetMs();               // milliseconds the clock was behind the source at the last sync
+    static uint32_t steppedSeconds();             // sum of the steps made by setTime(), adjustTime() and syncs, modulo 2^32
+
+    /**
+     * Warm start. The clock state (time, drift, status and how long ago it was synced) is saved
+     * through the given functions every `intervalSeconds`, and right after setTime(), adjustTime()
+     * or a sync steps the clock. At boot restoreSnapshot() sets the clock from the saved state before any sync
+     * source has answered, with timeStatus() timeEstimated until the first sync succeeds. The
+     * reset is assumed half way through a save interval, so the restored time is off by up to
+     * half the interval plus the time the device was off, which can be given if it is known.
+     * timeUncertaintyMs() is the bound: the uncertainty of the last sync, or of the snapshot,
+     * growing by TIME_DRIFT_BOUND_PPM since. The save function is called from inside now(),
+     * it must not call now() or anything that does.
+     */
+    static void    setSnapshotStorage(saveTimeSnapshot save, loadTimeSnapshot load, uint32_t intervalSeconds = 3600); // 0 interval: only saveSnapshot()
+    static bool    restoreSnapshot(uint32_t offSeconds = 0, uint32_t offUncertaintyMs = 0); // false if the time is set or there is no valid snapshot
+    static bool    saveSnapshot();       // save now, before a planned reset or sleep; false if the time is not set
+    static uint32_t timeUncertaintyMs(); // milliseconds the time may be off either way, 0xFFFFFFFF if it is not set
+
     static void refreshCache(time_t t);
+    static void timeElements(time_t t, tm &tme);  // all elements of t from one decomposition, safe to call from any thread
+    static cacheStats_t getCacheStats();
+    static void resetCacheStats();
+
+    /**
+     * Statistics and a trace of the clock for sizing sync intervals and finding callers that
+     * thrash the cache. Only counted when the library is built with TIME_STATS defined, which
+     * also defines TIME_CACHE_STATS; otherwise the counting is compiled out, the counts stay 0
+     * and the trace handler is never called. The handler is called from inside now(), it must
+     * not call now() or anything that does. printTimeStats() writes the statistics as text,
+     * for example to Serial.
+     */
+    static timeStats_t getTimeStats();
+    static void resetTimeStats();  // also resets the cache statistics
+    static void setTimeTrace(timeTraceHandler handler);  // 0 to stop tracing
+    static void printTimeStats(Print& out);
 
     /* low level functions to convert to and from system time                     */
     static void breakTime(time_t time, tm &tme);  // break time_t into elements
     static time_t makeTime(const tm &tme);  // convert time elements into time_t
 
+    /**
+     * Bulk versions of breakTime() and makeTime() that convert `count` elements between
+     * an array of time_t and columns of time elements. Each element gives exactly the
+     * same result as the single conversion. SSE2 or AVX2 kernels are selected at runtime
+     * on x86 hosts, other targets use a portable loop. Neither function uses the cache.
+     */
+    static void breakTimeBatch(const time_t* times, size_t count, const tmColumns_t& columns);
+    static void makeTimeBatch(const tmColumns_t& columns, size_t count, time_t* times);
+
+    /* time zone used by timeStr() and format(), UTC unless set */
+    static bool    setTimeZone(const char* tz);  // POSIX TZ string, false if it is not understood
+    static void    setTimeZone(const TimeZone& zone);
+    static const TimeZone& timeZone();
+
     /* return string representation of the current time */
     inline String timeStr()
     {
@@ -182,17 +949,35 @@ public:
         return format(now(), format_spec);
     }
 
-    void setFormat(const char* format)
+    /**
+     * Write the given time in the time zone into `buf` without heap allocation, with the format
+     * set by setFormat() or a compiled TimeFormat. Returns the length of the whole output as
+     * snprintf() does; the output is cut to fit and always terminated.
+     */
+    static size_t formatTo(char* buf, size_t size, time_t t);
+    static size_t formatTo(char* buf, size_t size, time_t t, const TimeFormat& format);
+
+    /**
+     * Parse a timestamp as written by format() and timeStr(): ISO 8601 and RFC 3339 such as
+     * "2023-11-14T22:13:20Z", "2023-11-14 23:13:20.250+01:00" or "2023-11-14", and asctime such
+     * as "Tue Nov 14 22:13:20 2023". A time without an offset is local time in the time zone.
+     * Returns the number of characters used, 0 if the text does not start with a valid timestamp.
+     */
+    static size_t parseTime(const char* text, size_t length, time_t& t);
+    static size_t parseTimeMs(const char* text, size_t length, time_ms_t& t);
+
+    // false if the format does not fit in a TimeFormat, formatTo() and format() then write nothing
+    bool setFormat(const char* format)
     {
         this->format_spec = format;
+        return compiledFormat.set(format);
     }
 
     const char* getFormat() const { return format_spec; }
 
 private:
-    static struct tm _tm;
     static const char* format_spec;
-    static String timeFormatImpl(tm* calendar_time, const char* format, int time_zone);
+    static TimeFormat compiledFormat;
 };
 
 extern TimeClass Time;
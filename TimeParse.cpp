@@ -0,0 +1,252 @@
+/* TimeParse.cpp
+ * Parsing of the ISO 8601, RFC 3339 and asctime timestamps written by the Time library
+ *
+ * "2023-11-14T22:13:20Z" and its variants share a fixed layout up to the seconds. Those 19
+ * characters are loaded into three words, all 14 digits and 5 separators are checked at once
+ * with the usual SWAR test, and the digits are then combined pairwise inside the words. The
+ * optional fraction and zone offset that follow are parsed one character at a time. The date is
+ * turned into days with daysFromCivil(), without going through time elements.
+ */
+
+#if ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+
+#include <string.h>
+#include "TimeLib.h"
+
+// 8 characters as a little endian word, the first character in the low byte
+static inline uint64_t loadWord(const char* s, size_t n)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (n == 8) {
+        uint64_t w;
+        memcpy(&w, s, 8);  // a single load
+        return w;
+    }
+#endif
+    uint64_t w = 0;
+    for (size_t i = 0; i < n; i++) {
+        w |= (uint64_t)(uint8_t)s[i] << (8 * i);
+    }
+    return w;
+}
+
+#define ZEROS 0x3030303030303030ULL
+
+// the bytes where mask is 0xFF, the others replaced by '0'
+static inline uint64_t digitBytes(uint64_t w, uint64_t mask)
+{
+    return (w & mask) | (ZEROS & ~mask);
+}
+
+// true if every byte is an ASCII digit: its high nibble is 3, and adding 6 does not carry into it
+static inline bool allDigits(uint64_t w)
+{
+    const uint64_t high = 0xF0F0F0F0F0F0F0F0ULL;
+    return (w & high) == ZEROS && ((w + 0x0606060606060606ULL) & high) == ZEROS;
+}
+
+// the two digit numbers starting at each byte of a word of digits, in the same byte
+static inline uint64_t digitPairs(uint64_t w)
+{
+    w -= ZEROS;
+    return w * 10 + (w >> 8);
+}
+
+static inline int pairAt(uint64_t pairs, int i)
+{
+    return (int)((pairs >> (8 * i)) & 0xFF);
+}
+
+static inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// checks the elements and combines them, false if the date does not exist or is outside time_t
+static bool combine(long year, int month, int day, int hour, int minute, int second, int64_t& seconds)
+{
+    if (year < 1969 || year > 2106 || month < 1 || month > 12 || day < 1 ||
+        day > daysInMonth(year, month) ||
+        hour > 23 || minute > 59 || second > 60) {  // 60 is a leap second, counted as the next minute
+        return false;
+    }
+    seconds = (int64_t)daysFromCivil(year, month, day) * 86400 + hour * 3600L + minute * 60 + second;
+    return true;
+}
+
+// [+|-]hh[[:]mm] or Z, in seconds east of UTC
+static size_t parseOffset(const char* s, size_t n, long& offset, bool& given)
+{
+    given = true;
+    if (n >= 1 && (s[0] == 'Z' || s[0] == 'z')) {
+        offset = 0;
+        return 1;
+    }
+    if (n < 3 || (s[0] != '+' && s[0] != '-') || !isDigit(s[1]) || !isDigit(s[2])) {
+        given = false;
+        return 0;
+    }
+    long hours = (s[1] - '0') * 10 + (s[2] - '0');
+    long minutes = 0;
+    size_t used = 3;
+    size_t colon = (n > 3 && s[3] == ':') ? 1 : 0;
+    if (n >= 5 + colon && isDigit(s[3 + colon]) && isDigit(s[4 + colon])) {
+        minutes = (s[3 + colon] - '0') * 10 + (s[4 + colon] - '0');
+        used = 5 + colon;
+    } else if (colon) {
+        return (size_t)-1;  // a colon without minutes
+    }
+    if (hours > 23 || minutes > 59) {
+        return (size_t)-1;
+    }
+    offset = (s[0] == '-' ? -1 : 1) * (hours * 3600 + minutes * 60);
+    return used;
+}
+
+// YYYY-MM-DD[(T|t| )hh:mm:ss[.fff...]][Z|+hh:mm], local time in the time zone without an offset
+static size_t parseIso8601(const char* s, size_t n, time_ms_t& t)
+{
+    int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+    size_t used = 0;
+    if (n >= 19) {
+        // the fixed part in one pass: "YYYY-MM-" "DDThh:mm" ":ss"
+        uint64_t w0 = loadWord(s, 8);
+        uint64_t w1 = loadWord(s + 8, 8);
+        uint64_t w2 = loadWord(s + 16, 3);
+        uint8_t sep = (uint8_t)s[10];
+        uint64_t d0 = digitBytes(w0, 0x00FFFF00FFFFFFFFULL);
+        uint64_t d1 = digitBytes(w1, 0xFFFF00FFFF00FFFFULL);
+        uint64_t d2 = digitBytes(w2, 0x000000000000FFFFULL << 8);
+        if (allDigits(d0) && allDigits(d1) && allDigits(d2) &&
+            (w0 & 0xFF0000FF00000000ULL) == 0x2D00002D00000000ULL &&   // '-' at 4 and 7
+            (w1 & 0x0000FF0000000000ULL) == 0x00003A0000000000ULL &&   // ':' at 13
+            (w2 & 0xFF) == ':' && (sep == 'T' || sep == 't' || sep == ' ')) {  // and 16
+            uint64_t p0 = digitPairs(d0), p1 = digitPairs(d1), p2 = digitPairs(d2);
+            year = pairAt(p0, 0) * 100 + pairAt(p0, 2);
+            month = pairAt(p0, 5);
+            day = pairAt(p1, 0);
+            hour = pairAt(p1, 3);
+            minute = pairAt(p1, 6);
+            second = pairAt(p2, 1);
+            used = 19;
+        }
+    }
+    if (used == 0) {
+        // the date alone, or a time that is not in the fixed layout
+        if (n < 10 || !isDigit(s[0]) || !isDigit(s[1]) || !isDigit(s[2]) || !isDigit(s[3]) || s[4] != '-' ||
+            !isDigit(s[5]) || !isDigit(s[6]) || s[7] != '-' || !isDigit(s[8]) || !isDigit(s[9])) {
+            return 0;
+        }
+        if (n > 10 && (s[10] == 'T' || s[10] == 't')) {
+            return 0;  // an incomplete time
+        }
+        year = (s[0] - '0') * 1000 + (s[1] - '0') * 100 + (s[2] - '0') * 10 + (s[3] - '0');
+        month = (s[5] - '0') * 10 + (s[6] - '0');
+        day = (s[8] - '0') * 10 + (s[9] - '0');
+        used = 10;
+    }
+
+    int ms = 0;
+    if (used == 19 && used < n && s[used] == '.') {
+        size_t digits = 0;
+        for (used++; used < n && isDigit(s[used]); used++, digits++) {
+            if (digits < 3) {
+                ms = ms * 10 + (s[used] - '0');
+            }
+        }
+        if (digits == 0) {
+            return 0;
+        }
+        for (; digits < 3; digits++) {
+            ms *= 10;
+        }
+    }
+
+    int64_t seconds;
+    if (!combine(year, month, day, hour, minute, second, seconds)) {
+        return 0;
+    }
+    long offset = 0;
+    bool given = false;
+    if (used >= 19) {
+        size_t zone = parseOffset(s + used, n - used, offset, given);
+        if (zone == (size_t)-1) {
+            return 0;
+        }
+        used += zone;
+    }
+    if (given) {
+        seconds -= offset;
+    } else {
+        seconds = TimeClass::timeZone().toUtc((time_t)seconds);
+    }
+    if (seconds < 0 || seconds > 0xFFFFFFFFLL) {
+        return 0;
+    }
+    t = (time_ms_t)seconds * 1000 + ms;
+    return used;
+}
+
+// Www Mmm dd hh:mm:ss yyyy as written by asctime() without the newline, local time in the time zone
+static size_t parseAsctime(const char* s, size_t n, time_ms_t& t)
+{
+    static const char weekdays[] = "SunMonTueWedThuFriSat";
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    if (n < 24 || s[3] != ' ' || s[7] != ' ' || s[10] != ' ' || s[13] != ':' || s[16] != ':' || s[19] != ' ' ||
+        (s[8] != ' ' && !isDigit(s[8])) || !isDigit(s[9]) || !isDigit(s[11]) || !isDigit(s[12]) ||
+        !isDigit(s[14]) || !isDigit(s[15]) || !isDigit(s[17]) || !isDigit(s[18]) ||
+        !isDigit(s[20]) || !isDigit(s[21]) || !isDigit(s[22]) || !isDigit(s[23])) {
+        return 0;
+    }
+    int wday = 0, month = 0;
+    while (wday < 7 && memcmp(s, weekdays + 3 * wday, 3)) {
+        wday++;
+    }
+    while (month < 12 && memcmp(s + 4, months + 3 * month, 3)) {
+        month++;
+    }
+    if (wday == 7 || month == 12) {
+        return 0;
+    }
+    int day = (s[8] == ' ' ? 0 : (s[8] - '0') * 10) + (s[9] - '0');
+    int hour = (s[11] - '0') * 10 + (s[12] - '0');
+    int minute = (s[14] - '0') * 10 + (s[15] - '0');
+    int second = (s[17] - '0') * 10 + (s[18] - '0');
+    long year = (s[20] - '0') * 1000 + (s[21] - '0') * 100 + (s[22] - '0') * 10 + (s[23] - '0');
+    int64_t seconds;
+    if (!combine(year, month + 1, day, hour, minute, second, seconds) ||
+        (daysFromCivil(year, month + 1, day) + 4) % 7 != wday) {  // Jan 1 1970 was a Thursday
+        return 0;
+    }
+    seconds = TimeClass::timeZone().toUtc((time_t)seconds);
+    if (seconds < 0 || seconds > 0xFFFFFFFFLL) {
+        return 0;
+    }
+    t = (time_ms_t)seconds * 1000;
+    return 24;
+}
+
+size_t TimeClass::parseTimeMs(const char* text, size_t length, time_ms_t& t)
+{
+    if (text == NULL) {
+        return 0;
+    }
+    if (length >= 1 && isDigit(text[0])) {
+        return parseIso8601(text, length, t);
+    }
+    return parseAsctime(text, length, t);
+}
+
+size_t TimeClass::parseTime(const char* text, size_t length, time_t& t)
+{
+    time_ms_t ms;
+    size_t used = parseTimeMs(text, length, ms);
+    if (used != 0) {
+        t = (time_t)(ms / 1000);
+    }
+    return used;
+}
@@ -0,0 +1,95 @@
+/* TimeStats.cpp
+ * Text dump of the clock statistics for use with the Time library
+ *
+ * Kept apart from Time.cpp so sketches that never print the statistics do not link the text.
+ * The histograms print only the buckets that counted something, as "<limit:count" with the
+ * limit in milliseconds and ">=" for the last bucket.
+ */
+
+#if ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+
+#include "TimeLib.h"
+
+static void printHistogram(Print& out, const uint32_t* buckets)
+{
+    bool any = false;
+    for (uint8_t i = 0; i < TIME_STATS_BUCKETS; i++) {
+        if (buckets[i] == 0) {
+            continue;
+        }
+        out.print(' ');
+        if (i < TIME_STATS_BUCKETS - 1) {
+            out.print('<');
+            out.print(1UL << i);
+        } else {
+            out.print(">=");
+            out.print(1UL << (i - 1));
+        }
+        out.print(':');
+        out.print(buckets[i]);
+        any = true;
+    }
+    if (!any) {
+        out.print(" none");
+    }
+    out.println();
+}
+
+void TimeClass::printTimeStats(Print& out)
+{
+    timeStats_t stats = getTimeStats();
+#ifndef TIME_STATS
+    out.println(F("time stats: not counted, build with TIME_STATS"));
+#endif
+    out.print(F("cache: hits "));
+    out.print(stats.cache.hits);
+    out.print(F(" incremental "));
+    out.print(stats.cache.incremental);
+    out.print(F(" full "));
+    out.println(stats.cache.full);
+
+    out.print(F("now: updates "));
+    out.print(stats.nowCalls);
+    out.print(F(" catch-ups "));
+    out.print(stats.catchUps);
+    out.print(F(" seconds "));
+    out.print(stats.catchUpSeconds);
+    out.print(F(" max "));
+    out.println(stats.catchUpMax);
+
+    out.print(F("sync: calls "));
+    out.print(stats.syncs);
+    out.print(F(" failed "));
+    out.print(stats.syncFailures);
+    out.print(F(" max us "));
+    out.println(stats.syncLatencyMaxUs);
+    out.print(F("sync ms:"));
+    printHistogram(out, stats.syncLatency);
+
+    out.print(F("steps: "));
+    out.print(stats.steps);
+    out.print(F(" last ms "));
+    out.print((long)stats.lastStepMs);
+    out.print(F(" slews "));
+    out.println(stats.slews);
+    out.print(F("step ms:"));
+    printHistogram(out, stats.stepSize);
+
+    out.print(F("timeStatus: calls "));
+    out.print(stats.statusCalls);
+    out.print(F(" us "));
+    out.print(stats.statusMicros);
+    out.print(F(" max us "));
+    out.println(stats.statusMaxMicros);
+
+    out.print(F("drift: ppb "));
+    out.print(stats.driftPpb);
+    out.print(F(" offset ms "));
+    out.print(stats.offsetMs);
+    out.print(F(" samples "));
+    out.println(stats.driftSamples);
+}
@@ -0,0 +1,291 @@
+/* TimeWheel.cpp
+ * Alarms in a hierarchical timing wheel for use with the Time library
+ *
+ * The levels follow the clock: an alarm in the current minute is in the seconds level at its
+ * second, one later in the current hour is in the minutes level at its minute, and so on. When
+ * the wheel reaches a new minute, hour or day, the alarms of that slot move down to the level
+ * below, so each alarm moves at most four times before it fires. A level that is empty lets
+ * service() jump to the next boundary of the level above instead of visiting every second.
+ *
+ * Alarms are kept in lists linked through the alarms themselves, each alarm pointing back at
+ * the pointer to it, so one can be taken out of any list, including the list being fired, in
+ * constant time and without allocation.
+ */
+
+#if ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+
+#include "TimeLib.h"
+
+TimeWheel::TimeWheel()
+{
+    for (uint8_t i = 0; i < 60; i++) {
+        seconds[i] = NULL;
+        minutes[i] = NULL;
+    }
+    for (uint8_t i = 0; i < 24; i++) {
+        hours[i] = NULL;
+    }
+    for (uint8_t i = 0; i < TIME_WHEEL_DAYS; i++) {
+        days[i] = NULL;
+    }
+    later = NULL;
+    due = NULL;
+    firing = NULL;
+    for (uint8_t i = 0; i < 4; i++) {
+        levelCount[i] = 0;
+    }
+    scheduled = 0;
+    current = 0;
+    steps = 0;
+    started = false;
+}
+
+// the wheel starts at the time of the first alarm, now() cannot be called before setup()
+void TimeWheel::start()
+{
+    if (!started) {
+        current = (uint32_t)TimeClass::now();
+        steps = TimeClass::steppedSeconds();
+        started = true;
+    }
+}
+
+void TimeWheel::place(TimeAlarm& alarm)
+{
+    uint32_t w = alarm.when;
+    TimeAlarm** list;
+    int8_t level;
+    if ((int32_t)(w - current) <= 0) {
+        list = &due;
+        level = -1;
+    } else if (w / 60 == current / 60) {
+        list = &seconds[w % 60];
+        level = 0;
+    } else if (w / 3600 == current / 3600) {
+        list = &minutes[w / 60 % 60];
+        level = 1;
+    } else if (w / 86400 == current / 86400) {
+        list = &hours[w / 3600 % 24];
+        level = 2;
+    } else if (w / 86400 - current / 86400 < TIME_WHEEL_DAYS) {
+        list = &days[w / 86400 % TIME_WHEEL_DAYS];
+        level = 3;
+    } else {
+        list = &later;
+        level = -1;
+    }
+    alarm.next = *list;
+    if (alarm.next != NULL) {
+        alarm.next->pprev = &alarm.next;
+    }
+    *list = &alarm;
+    alarm.pprev = list;
+    alarm.level = level;
+    if (level >= 0) {
+        levelCount[level]++;
+    }
+    scheduled++;
+}
+
+void TimeWheel::unlink(TimeAlarm& alarm)
+{
+    *alarm.pprev = alarm.next;
+    if (alarm.next != NULL) {
+        alarm.next->pprev = alarm.pprev;
+    }
+    alarm.next = NULL;
+    alarm.pprev = NULL;
+    if (alarm.level >= 0) {
+        levelCount[alarm.level]--;
+    }
+    scheduled--;
+}
+
+// take the alarms out of list onto a plain chain through next, they are not scheduled while on it
+void TimeWheel::gather(TimeAlarm*& list, TimeAlarm*& chain)
+{
+    while (list != NULL) {
+        TimeAlarm* alarm = list;
+        unlink(*alarm);
+        alarm->next = chain;
+        chain = alarm;
+    }
+}
+
+// the slot has come into the level below, place its alarms again; those in later may stay there
+void TimeWheel::redistribute(TimeAlarm*& list)
+{
+    TimeAlarm* chain = NULL;
+    gather(list, chain);
+    while (chain != NULL) {
+        TimeAlarm* alarm = chain;
+        chain = alarm->next;
+        place(*alarm);
+    }
+}
+
+// fire the alarms of a slot that is due, repeating alarms are placed again after horizon first
+uint16_t TimeWheel::fire(TimeAlarm*& list, int8_t level, uint32_t horizon)
+{
+    // move the slot to a list of its own, so alarms the handlers schedule for now go to due
+    // instead of being fired in this loop, and alarms they cancel are simply taken out of it
+    firing = list;
+    list = NULL;
+    if (firing != NULL) {
+        firing->pprev = &firing;
+    }
+    for (TimeAlarm* alarm = firing; alarm != NULL; alarm = alarm->next) {
+        if (level >= 0) {
+            levelCount[level]--;
+        }
+        alarm->level = -1;
+    }
+
+    uint16_t fired = 0;
+    while (firing != NULL) {
+        TimeAlarm& alarm = *firing;
+        unlink(alarm);
+        if (alarm.period != 0) {
+            alarm.when += alarm.period;
+            if ((int32_t)(alarm.when - horizon) <= 0) {
+                alarm.when += ((horizon - alarm.when) / alarm.period + 1) * alarm.period;  // skip the missed periods
+            }
+            place(alarm);
+        }
+        alarm.handler(alarm.context);
+        fired++;
+    }
+    return fired;
+}
+
+// the clock was stepped since the wheel last looked: place every alarm again around the same
+// instant of the new clock, with the alarms after a duration moved along with it
+void TimeWheel::followSteps()
+{
+    uint32_t total = TimeClass::steppedSeconds();
+    if (total == steps) {
+        return;
+    }
+    uint32_t delta = total - steps;
+    steps = total;
+
+    TimeAlarm* all = NULL;
+    for (uint8_t i = 0; i < 60; i++) {
+        gather(seconds[i], all);
+        gather(minutes[i], all);
+    }
+    for (uint8_t i = 0; i < 24; i++) {
+        gather(hours[i], all);
+    }
+    for (uint8_t i = 0; i < TIME_WHEEL_DAYS; i++) {
+        gather(days[i], all);
+    }
+    gather(later, all);
+    gather(due, all);
+
+    current += delta;
+    while (all != NULL) {
+        TimeAlarm* alarm = all;
+        all = alarm->next;
+        if (alarm->elapsed) {
+            alarm->when += delta;
+        }
+        place(*alarm);
+    }
+}
+
+void TimeWheel::schedule(TimeAlarm& alarm, uint32_t when, uint32_t period, bool elapsed, alarmHandler handler, void* context)
+{
+    start();
+    followSteps();
+    if (alarm.isScheduled()) {
+        unlink(alarm);
+    }
+    alarm.when = when;
+    alarm.period = period;
+    alarm.elapsed = elapsed;
+    alarm.handler = handler;
+    alarm.context = context;
+    place(alarm);
+}
+
+void TimeWheel::at(TimeAlarm& alarm, time_t t, alarmHandler handler, void* context)
+{
+    schedule(alarm, (uint32_t)t, 0, false, handler, context);
+}
+
+void TimeWheel::repeat(TimeAlarm& alarm, time_t first, uint32_t period, alarmHandler handler, void* context)
+{
+    schedule(alarm, (uint32_t)first, period != 0 ? period : 1, false, handler, context);
+}
+
+void TimeWheel::after(TimeAlarm& alarm, uint32_t seconds, alarmHandler handler, void* context)
+{
+    uint32_t t = (uint32_t)TimeClass::now();  // before followSteps(), a step made by this now() is then followed too
+    schedule(alarm, t + seconds, 0, true, handler, context);
+}
+
+void TimeWheel::every(TimeAlarm& alarm, uint32_t period, alarmHandler handler, void* context)
+{
+    uint32_t t = (uint32_t)TimeClass::now();
+    if (period == 0) {
+        period = 1;
+    }
+    schedule(alarm, t + period, period, true, handler, context);
+}
+
+void TimeWheel::cancel(TimeAlarm& alarm)
+{
+    if (alarm.isScheduled()) {
+        unlink(alarm);
+    }
+}
+
+uint16_t TimeWheel::service()
+{
+    uint32_t t = (uint32_t)TimeClass::now();
+    start();
+    followSteps();
+
+    uint16_t fired = fire(due, -1, t);
+    while ((int32_t)(t - current) > 0) {
+        uint32_t next = current + 1;
+        if (levelCount[0] == 0) {
+            // nothing in this minute, or hour, or day: go straight to its end
+            next = (current / 60 + 1) * 60;
+            if (levelCount[1] == 0) {
+                next = (current / 3600 + 1) * 3600;
+                if (levelCount[2] == 0) {
+                    next = (current / 86400 + 1) * 86400;
+                }
+            }
+            if ((int32_t)(next - t) > 0) {
+                current = t;
+                break;
+            }
+        }
+        current = next;
+        if (current % 60 == 0) {
+            if (current % 3600 == 0) {
+                if (current % 86400 == 0) {
+                    if (current / 86400 % TIME_WHEEL_DAYS == 0) {
+                        redistribute(later);
+                    }
+                    redistribute(days[current / 86400 % TIME_WHEEL_DAYS]);
+                }
+                redistribute(hours[current / 3600 % 24]);
+            }
+            redistribute(minutes[current / 60 % 60]);
+        }
+        fired += fire(due, -1, t);  // alarms at current that came down from the minutes
+        fired += fire(seconds[current % 60], 0, t);
+        if (TimeClass::steppedSeconds() != steps) {
+            break;  // a handler set the clock, the next service() follows the step
+        }
+    }
+    return fired;
+}
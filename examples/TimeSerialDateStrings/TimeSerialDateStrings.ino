@@ -51,24 +51,25 @@ void loop(){
 }
 
 void digitalClockDisplay() {
-  // digital clock display of the time
-  Serial.print(hour());
-  printDigits(minute());
-  printDigits(second());
+  // digital clock display of the time, all the fields from one reading of the clock
+  DateTime t = DateTime::now();
+  Serial.print(t.hour());
+  printDigits(t.minute());
+  printDigits(t.second());
   Serial.print(" ");
   if(isLongFormat)
-    Serial.print(dayStr(weekday()));
+    Serial.print(dayStr(t.weekday()));
   else  
-   Serial.print(dayShortStr(weekday()));
+   Serial.print(dayShortStr(t.weekday()));
   Serial.print(" ");
-  Serial.print(day());
+  Serial.print(t.day());
   Serial.print(" ");
   if(isLongFormat)
-     Serial.print(monthStr(month()));
+     Serial.print(monthStr(t.month()));
   else
-     Serial.print(monthShortStr(month()));
+     Serial.print(monthShortStr(t.month()));
   Serial.print(" ");
-  Serial.print(year()); 
+  Serial.print(t.year()); 
   Serial.println(); 
 }
 
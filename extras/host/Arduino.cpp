@@ -0,0 +1,116 @@
+/* Arduino.cpp
+ * Host implementation of the Arduino core stand-in, see Arduino.h
+ */
+
+#include "Arduino.h"
+
+static uint64_t hostMicros = 0;
+
+uint32_t millis()
+{
+    return (uint32_t)(hostMicros / 1000);
+}
+
+uint32_t micros()
+{
+    return (uint32_t)hostMicros;
+}
+
+void delay(uint32_t ms)
+{
+    advanceHostMillis(ms);
+}
+
+void setHostMicros(uint64_t us)
+{
+    hostMicros = us;
+}
+
+void advanceHostMicros(uint64_t us)
+{
+    hostMicros += us;
+}
+
+/*==============================================================================*/
+
+size_t Print::write(const uint8_t* buf, size_t size)
+{
+    size_t n = 0;
+    while (size--)
+        n += write(*buf++);
+    return n;
+}
+
+size_t Print::print(long n)
+{
+    char text[24];
+    snprintf(text, sizeof(text), "%ld", n);
+    return write(text);
+}
+
+size_t Print::print(unsigned long n)
+{
+    char text[24];
+    snprintf(text, sizeof(text), "%lu", n);
+    return write(text);
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    return putchar(c) == EOF ? 0 : 1;
+}
+
+HardwareSerial Serial;
+
+/*==============================================================================*/
+
+String::String(const char* cstr) : buffer(NULL), len(0)
+{
+    if (cstr)
+        copy(cstr, strlen(cstr));
+}
+
+String::String(const String& other) : buffer(NULL), len(0)
+{
+    copy(other.c_str(), other.len);
+}
+
+String::String(String&& other) : buffer(other.buffer), len(other.len)
+{
+    other.buffer = NULL;
+    other.len = 0;
+}
+
+String::~String()
+{
+    delete[] buffer;
+}
+
+String& String::operator=(const String& other)
+{
+    if (this != &other)
+        copy(other.c_str(), other.len);
+    return *this;
+}
+
+String& String::operator=(String&& other)
+{
+    if (this != &other) {
+        delete[] buffer;
+        buffer = other.buffer;
+        len = other.len;
+        other.buffer = NULL;
+        other.len = 0;
+    }
+    return *this;
+}
+
+void String::copy(const char* cstr, unsigned int length)
+{
+    char* p = new char[length + 1];
+    memcpy(p, cstr, length);
+    p[length] = 0;
+    delete[] buffer;
+    buffer = p;
+    len = length;
+}
@@ -0,0 +1,94 @@
+/* Arduino.h
+ * Minimal stand-in for the Arduino core, used to build the Time library on a host computer
+ *
+ * Only what the library sources need is provided: millis() and micros() driven by a counter
+ * that the host program controls, a small heap backed String, a Print with a Serial that
+ * writes to stdout, and the avr/pgmspace macros mapped onto ordinary memory.
+ */
+
+#ifndef _Host_Arduino_h
+#define _Host_Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/* fake time base */
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);            // advances the fake clock, does not sleep
+void setHostMicros(uint64_t us);    // set the value behind millis() and micros()
+void advanceHostMicros(uint64_t us);
+inline void setHostMillis(uint32_t ms) { setHostMicros((uint64_t)ms * 1000); }
+inline void advanceHostMillis(uint32_t ms) { advanceHostMicros((uint64_t)ms * 1000); }
+
+/* pgmspace */
+#define PROGMEM
+#define PGM_P const char*
+#define PSTR(s) (s)
+#define F(s) (s)
+#define strcpy_P(dest, src) strcpy((dest), (src))
+#define strlen_P(s) strlen((s))
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+#define pgm_read_ptr(addr) (*(const void* const*)(addr))
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+class String {
+public:
+    String(const char* cstr = "");
+    String(const String& other);
+    String(String&& other);
+    ~String();
+
+    String& operator=(const String& other);
+    String& operator=(String&& other);
+
+    const char* c_str() const { return buffer ? buffer : ""; }
+    unsigned int length() const { return len; }
+    bool operator==(const String& other) const { return !strcmp(c_str(), other.c_str()); }
+    bool operator==(const char* cstr) const { return !strcmp(c_str(), cstr); }
+    bool operator!=(const String& other) const { return !(*this == other); }
+
+private:
+    void copy(const char* cstr, unsigned int length);
+
+    char* buffer;
+    unsigned int len;
+};
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    size_t write(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+    size_t write(const uint8_t* buf, size_t size);
+
+    size_t print(const char* s) { return write(s); }
+    size_t print(const String& s) { return write(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char n) { return print((unsigned long)n); }
+    size_t print(int n) { return print((long)n); }
+    size_t print(unsigned int n) { return print((unsigned long)n); }
+    size_t print(long n);
+    size_t print(unsigned long n);
+
+    size_t println() { return write("\r\n"); }
+    template <typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+};
+
+// writes to stdout
+class HardwareSerial : public Print {
+public:
+    void begin(unsigned long) {}
+    size_t write(uint8_t c) override;
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+#endif /* _Host_Arduino_h */
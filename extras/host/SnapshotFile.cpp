@@ -0,0 +1,42 @@
+/* SnapshotFile.cpp
+ * File backed snapshot storage for the host build, see SnapshotFile.h
+ *
+ * The snapshot is written to a temporary file that is then renamed over the old one, so a crash
+ * while saving leaves the previous snapshot, as a device would with two slots in flash.
+ */
+
+#include "SnapshotFile.h"
+
+static const char* snapshotPath = "time.snapshot";
+
+void setSnapshotFile(const char* path)
+{
+    snapshotPath = path;
+}
+
+bool saveSnapshotFile(const timeSnapshot_t& snapshot)
+{
+    char temp[256];
+    if (snprintf(temp, sizeof(temp), "%s.tmp", snapshotPath) >= (int)sizeof(temp))
+        return false;
+    FILE* f = fopen(temp, "wb");
+    if (f == NULL)
+        return false;
+    bool ok = fwrite(&snapshot, sizeof(snapshot), 1, f) == 1;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(temp, snapshotPath) != 0) {
+        remove(temp);
+        return false;
+    }
+    return true;
+}
+
+bool loadSnapshotFile(timeSnapshot_t& snapshot)
+{
+    FILE* f = fopen(snapshotPath, "rb");
+    if (f == NULL)
+        return false;
+    bool ok = fread(&snapshot, sizeof(snapshot), 1, f) == 1;
+    fclose(f);
+    return ok;
+}
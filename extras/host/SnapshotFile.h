@@ -0,0 +1,19 @@
+/* SnapshotFile.h
+ * File backed snapshot storage for the host build, a stand-in for EEPROM or flash
+ *
+ *   setSnapshotFile("clock.snapshot");
+ *   setSnapshotStorage(saveSnapshotFile, loadSnapshotFile);
+ *   restoreSnapshot();
+ */
+
+#ifndef _Host_SnapshotFile_h
+#define _Host_SnapshotFile_h
+
+#include "Arduino.h"
+#include "TimeLib.h"
+
+void setSnapshotFile(const char* path);  // the path is not copied
+bool saveSnapshotFile(const timeSnapshot_t& snapshot);
+bool loadSnapshotFile(timeSnapshot_t& snapshot);
+
+#endif /* _Host_SnapshotFile_h */
@@ -0,0 +1,588 @@
+/* TimeBench.cpp
+ * Microbenchmarks for the hot paths of the Time library, built on the host with the Arduino stand-in
+ *
+ * usage: time_bench [filter]   run only the benchmarks whose name contains filter
+ *
+ * Each benchmark reports the mean time per operation and the number of heap allocations made
+ * through operator new per operation. The clock behind millis() only moves when a benchmark
+ * advances it, so now() measures the library and not the host clock.
+ */
+
+#include <Arduino.h>
+#include <TimeLib.h>
+
+#include <chrono>
+#include <new>
+
+static unsigned long allocations = 0;
+
+void* operator new(size_t size)
+{
+    allocations++;
+    void* p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+static volatile uint32_t sink;
+
+#define SAMPLES 4096    // must be a power of 2
+#define SAMPLE(i) ((i) & (SAMPLES - 1))
+
+static time_t times[SAMPLES];
+static tm elements[SAMPLES];
+static uint16_t years[SAMPLES];
+static uint8_t months[SAMPLES], days[SAMPLES], hours[SAMPLES], minutes[SAMPLES], seconds[SAMPLES], wdays[SAMPLES];
+static const tmColumns_t columns = { years, months, days, hours, minutes, seconds, wdays };
+static time_t batchTimes[SAMPLES];
+
+static void setupSamples()
+{
+    uint32_t seed = 12345;
+    for (int i = 0; i < SAMPLES; i++) {
+        seed = seed * 1664525 + 1013904223;  // spread over the whole 1970-2106 range
+        times[i] = seed;
+        TimeClass::breakTime(times[i], elements[i]);
+    }
+}
+
+/*==============================================================================*/
+/* benchmarks, each runs n operations and returns the number of operations done */
+
+static uint32_t benchBreakTime(uint32_t n)
+{
+    tm tme;
+    for (uint32_t i = 0; i < n; i++) {
+        TimeClass::breakTime(times[SAMPLE(i)], tme);
+        sink = tme.tm_mday;
+    }
+    return n;
+}
+
+static uint32_t benchMakeTime(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        sink = TimeClass::makeTime(elements[SAMPLE(i)]);
+    return n;
+}
+
+static uint32_t benchBreakTimeBatch(uint32_t n)
+{
+    n = (n + SAMPLES - 1) / SAMPLES;
+    for (uint32_t i = 0; i < n; i++) {
+        TimeClass::breakTimeBatch(times, SAMPLES, columns);
+        sink = days[i & 7];
+    }
+    return n * SAMPLES;
+}
+
+static uint32_t benchMakeTimeBatch(uint32_t n)
+{
+    TimeClass::breakTimeBatch(times, SAMPLES, columns);
+    n = (n + SAMPLES - 1) / SAMPLES;
+    for (uint32_t i = 0; i < n; i++) {
+        TimeClass::makeTimeBatch(columns, SAMPLES, batchTimes);
+        sink = batchTimes[i & 7];
+    }
+    return n * SAMPLES;
+}
+
+static uint32_t benchNow(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        sink = TimeClass::now();
+    return n;
+}
+
+static uint32_t benchNowStall(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++) {
+        advanceHostMillis(SECS_PER_DAY * 1000);
+        sink = TimeClass::now();
+    }
+    return n;
+}
+
+static uint32_t benchNowMs(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        sink = (uint32_t)TimeClass::nowMs();
+    return n;
+}
+
+static uint32_t benchNowTick(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++) {
+        advanceHostMillis(1000);
+        sink = TimeClass::now();
+    }
+    return n;
+}
+
+static uint32_t benchCacheHit(uint32_t n)
+{
+    time_t t = times[0];
+    for (uint32_t i = 0; i < n; i++)
+        sink = TimeClass::hour(t);
+    return n;
+}
+
+static uint32_t benchCacheNextSecond(uint32_t n)
+{
+    time_t t = times[0];
+    for (uint32_t i = 0; i < n; i++)
+        sink = TimeClass::second(t + i);
+    return n;
+}
+
+static uint32_t benchCacheMiss(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        sink = TimeClass::hour(times[SAMPLE(i)]);
+    return n;
+}
+
+static uint32_t benchDateNextSecond(uint32_t n)
+{
+    time_t t = times[0];
+    for (uint32_t i = 0; i < n; i++)
+        sink = TimeClass::day(t + i);
+    return n;
+}
+
+static uint32_t benchDateMiss(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        sink = TimeClass::day(times[SAMPLE(i)]);
+    return n;
+}
+
+static uint32_t benchAllFields(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++) {
+        time_t t = times[SAMPLE(i)];
+        sink = TimeClass::year(t) + TimeClass::month(t) + TimeClass::day(t)
+             + TimeClass::hour(t) + TimeClass::minute(t) + TimeClass::second(t);
+    }
+    return n;
+}
+
+static uint32_t benchDateTimeFields(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++) {
+        DateTime t(times[SAMPLE(i)]);
+        sink = t.year() + t.month() + t.day() + t.hour() + t.minute() + t.second();
+    }
+    return n;
+}
+
+static uint32_t benchTimeStr(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        sink = Time.timeStr(times[SAMPLE(i)]).length();
+    return n;
+}
+
+static uint32_t benchFormatDefault(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        sink = Time.format(times[SAMPLE(i)]).length();
+    return n;
+}
+
+static uint32_t benchFormatISO8601(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        sink = Time.format(times[SAMPLE(i)], TIME_FORMAT_ISO8601_FULL).length();
+    return n;
+}
+
+static uint32_t benchFormatTo(uint32_t n)
+{
+    static const TimeFormat iso8601(TIME_FORMAT_ISO8601_FULL);
+    char buf[32];
+    for (uint32_t i = 0; i < n; i++)
+        sink = TimeClass::formatTo(buf, sizeof(buf), times[SAMPLE(i)], iso8601);
+    return n;
+}
+
+static uint32_t benchFormatToNextSecond(uint32_t n)
+{
+    static const TimeFormat iso8601(TIME_FORMAT_ISO8601_FULL);
+    char buf[32];
+    time_t t = times[0];
+    for (uint32_t i = 0; i < n; i++)
+        sink = TimeClass::formatTo(buf, sizeof(buf), t + i, iso8601);
+    return n;
+}
+
+static uint32_t benchDateTimeFormatTo(uint32_t n)
+{
+    char buf[DATE_TIME_ISO_SIZE];
+    for (uint32_t i = 0; i < n; i++)
+        sink = DateTime(times[SAMPLE(i)], 3600).formatTo(buf, sizeof(buf));
+    return n;
+}
+
+static uint32_t benchStampNextSecond(uint32_t n)
+{
+    static TimeStamper stamper(TIME_FORMAT_ISO8601_FULL);
+    char buf[32];
+    time_t t = times[0];
+    for (uint32_t i = 0; i < n; i++)
+        sink = stamper.stampTo(buf, sizeof(buf), t + i);
+    return n;
+}
+
+static uint32_t benchStampSameSecond(uint32_t n)
+{
+    static TimeStamper stamper(TIME_FORMAT_ISO8601_FULL);
+    char buf[32];
+    time_t t = times[0];
+    for (uint32_t i = 0; i < n; i++)
+        sink = stamper.stampTo(buf, sizeof(buf), t + i / 1000);
+    return n;
+}
+
+static char isoTexts[SAMPLES][32];
+static char asctimeTexts[SAMPLES][32];
+
+static void setupTexts()
+{
+    static const TimeFormat iso8601(TIME_FORMAT_ISO8601_FULL), asctime(TIME_FORMAT_DEFAULT);
+    for (int i = 0; i < SAMPLES; i++) {
+        TimeClass::formatTo(isoTexts[i], sizeof(isoTexts[i]), times[i], iso8601);
+        TimeClass::formatTo(asctimeTexts[i], sizeof(asctimeTexts[i]), times[i], asctime);
+    }
+}
+
+static uint32_t benchParseISO8601(uint32_t n)
+{
+    time_t t;
+    for (uint32_t i = 0; i < n; i++) {
+        TimeClass::parseTime(isoTexts[SAMPLE(i)], 20, t);
+        sink = (uint32_t)t;
+    }
+    return n;
+}
+
+static uint32_t benchParseAsctime(uint32_t n)
+{
+    time_t t;
+    for (uint32_t i = 0; i < n; i++) {
+        TimeClass::parseTime(asctimeTexts[SAMPLE(i)], 24, t);
+        sink = (uint32_t)t;
+    }
+    return n;
+}
+
+static const TimeZone cet("CET-1CEST,M3.5.0,M10.5.0/3");
+
+static uint32_t benchZoneNextSecond(uint32_t n)
+{
+    time_t t = times[0];
+    for (uint32_t i = 0; i < n; i++)
+        sink = cet.offset(t + i);
+    return n;
+}
+
+static uint32_t benchZoneMiss(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        sink = cet.offset(times[SAMPLE(i)]);
+    return n;
+}
+
+static uint32_t benchMonthStr(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        sink = Time.monthStr(1 + i % 12)[0];
+    return n;
+}
+
+static uint32_t benchMonthShortStr(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        sink = Time.monthShortStr(1 + i % 12)[0];
+    return n;
+}
+
+static uint32_t benchDayStr(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        sink = Time.dayStr(1 + i % 7)[0];
+    return n;
+}
+
+static uint32_t benchDayShortStr(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        sink = Time.dayShortStr(1 + i % 7)[0];
+    return n;
+}
+
+static uint32_t benchMonthName(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        sink = Time.monthName(1 + i % 12).length;
+    return n;
+}
+
+static const char* const lookupNames[] = { "January", "feb", "Sunday", "sat", "DECEMBER", "Thu", "Mayday", "Err" };
+
+static uint32_t benchMonthFromName(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++) {
+        const char* name = lookupNames[i % 8];
+        sink = Time.monthFromName(name, strlen(name));
+    }
+    return n;
+}
+
+#define WHEEL_ALARMS 1024
+static TimeWheel wheel;
+static TimeAlarm wheelAlarms[WHEEL_ALARMS];
+
+static void countAlarm(void* context)
+{
+    sink += (uint32_t)(uintptr_t)context;
+}
+
+static uint32_t benchWheelSchedule(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++) {
+        TimeAlarm& alarm = wheelAlarms[i % WHEEL_ALARMS];
+        wheel.after(alarm, 1 + times[SAMPLE(i)] % 100000, countAlarm);
+        wheel.cancel(alarm);
+    }
+    return n;
+}
+
+// alarms every 1 to 600 seconds, serviced every second: reports the time per alarm fired
+static uint32_t benchWheelFire(uint32_t n)
+{
+    for (uint32_t i = 0; i < WHEEL_ALARMS; i++)
+        wheel.every(wheelAlarms[i], 1 + times[SAMPLE(i)] % 600, countAlarm);
+    uint32_t fired = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        advanceHostMillis(1000);
+        fired += wheel.service();
+    }
+    for (uint32_t i = 0; i < WHEEL_ALARMS; i++)
+        wheel.cancel(wheelAlarms[i]);
+    return fired != 0 ? fired : 1;
+}
+
+// a log written about once a second with a few milliseconds of jitter and an occasional pause
+static time_ms_t logTimes[SAMPLES];
+static uint8_t logCode[SAMPLES * TIME_CODEC_MAX_RECORD];
+static size_t logCodeSize;
+static char benchNote[64];  // printed after the timing, for results that are not times
+
+static void setupLog()
+{
+    uint32_t seed = 777;
+    time_ms_t t = (time_ms_t)times[0] * 1000;
+    for (int i = 0; i < SAMPLES; i++) {
+        seed = seed * 1664525 + 1013904223;
+        t += (seed >> 28) == 0 ? 60000 + (seed >> 8) % 5000 : 1000 + (int)((seed >> 8) % 7) - 3;
+        logTimes[i] = t;
+    }
+    TimeEncoder encoder(true);
+    logCodeSize = 0;
+    for (int i = 0; i < SAMPLES; i++)
+        logCodeSize += encoder.encodeMs(logTimes[i], logCode + logCodeSize, sizeof(logCode) - logCodeSize);
+}
+
+static uint32_t benchCronNext(uint32_t n)
+{
+    static const TimeCron workHours("*/15 8-18 * * MON-FRI");
+    for (uint32_t i = 0; i < n; i++)
+        sink = (uint32_t)workHours.next(times[SAMPLE(i)]);
+    return n;
+}
+
+static uint32_t benchCronNextRare(uint32_t n)
+{
+    static const TimeCron firstMonday("30 2 * * MON#1");
+    for (uint32_t i = 0; i < n; i++)
+        sink = (uint32_t)firstMonday.next(times[SAMPLE(i)]);
+    return n;
+}
+
+// per fire time, a week of a job every 15 minutes in working hours
+static uint32_t benchCronFireTimes(uint32_t n)
+{
+    static const TimeCron workHours("*/15 8-18 * * MON-FRI");
+    time_t fired[256];
+    uint32_t count = 0;
+    for (uint32_t i = 0; count < n; i++) {
+        time_t from = times[SAMPLE(i)];
+        count += workHours.fireTimes(from, from + SECS_PER_WEEK, fired, 256);
+    }
+    return count;
+}
+
+static uint32_t benchCodecEncode(uint32_t n)
+{
+    uint8_t buf[TIME_CODEC_MAX_RECORD];
+    TimeEncoder encoder(true);
+    size_t bytes = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (SAMPLE(i) == 0)
+            encoder.reset();  // the log starts again
+        bytes += encoder.encodeMs(logTimes[SAMPLE(i)], buf, sizeof(buf));
+        sink += buf[0];
+    }
+    // text as a logger writes it: ISO 8601 with milliseconds and a newline
+    static const TimeFormat iso(TIME_FORMAT_ISO8601_FULL);
+    char text[40];
+    size_t textBytes = TimeClass::formatTo(text, sizeof(text), (time_t)(logTimes[0] / 1000), iso) + 5;
+    snprintf(benchNote, sizeof(benchNote), "%.2f bytes/time, raw %u, text %u",
+             (double)bytes / n, (unsigned)sizeof(time_ms_t), (unsigned)textBytes);
+    return n;
+}
+
+static uint32_t benchCodecDecode(uint32_t n)
+{
+    static time_ms_t decoded[SAMPLES];
+    uint32_t done = 0;
+    while (done < n) {
+        TimeDecoder decoder(logCode, logCodeSize);
+        done += (uint32_t)decoder.decodeMs(decoded, SAMPLES);
+        sink += (uint32_t)decoded[SAMPLES - 1];
+    }
+    return done;
+}
+
+static uint32_t benchCodecNext(uint32_t n)
+{
+    TimeDecoder decoder(logCode, logCodeSize);
+    for (uint32_t i = 0; i < n; i++) {
+        time_ms_t t;
+        if (!decoder.nextMs(t)) {
+            decoder = TimeDecoder(logCode, logCodeSize);
+            decoder.nextMs(t);
+        }
+        sink += (uint32_t)t;
+    }
+    return n;
+}
+
+static uint32_t benchCodecSeek(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++) {
+        TimeDecoder decoder(logCode, logCodeSize);
+        sink += decoder.seekMs(logTimes[SAMPLE(i * 2654435761u)]);
+    }
+    return n;
+}
+
+/*==============================================================================*/
+
+typedef uint32_t (*benchFunction)(uint32_t n);
+
+static const struct {
+    const char* name;
+    benchFunction run;
+} benchmarks[] = {
+    { "breakTime",              benchBreakTime },
+    { "makeTime",               benchMakeTime },
+    { "breakTimeBatch",         benchBreakTimeBatch },
+    { "makeTimeBatch",          benchMakeTimeBatch },
+    { "now",                    benchNow },
+    { "now/tick",               benchNowTick },
+    { "now/dayStall",           benchNowStall },
+    { "nowMs",                  benchNowMs },
+    { "refreshCache/hit",       benchCacheHit },
+    { "refreshCache/nextSecond", benchCacheNextSecond },
+    { "refreshCache/miss",      benchCacheMiss },
+    { "refreshCache/dayNextSecond", benchDateNextSecond },
+    { "refreshCache/dayMiss",   benchDateMiss },
+    { "refreshCache/allFields", benchAllFields },
+    { "dateTime/allFields",     benchDateTimeFields },
+    { "timeStr",                benchTimeStr },
+    { "format/default",         benchFormatDefault },
+    { "format/iso8601",         benchFormatISO8601 },
+    { "formatTo/iso8601",       benchFormatTo },
+    { "formatTo/nextSecond",    benchFormatToNextSecond },
+    { "dateTime/formatTo",      benchDateTimeFormatTo },
+    { "stamp/nextSecond",       benchStampNextSecond },
+    { "stamp/sameSecond",       benchStampSameSecond },
+    { "parseTime/iso8601",      benchParseISO8601 },
+    { "parseTime/asctime",      benchParseAsctime },
+    { "timeZone/nextSecond",    benchZoneNextSecond },
+    { "timeZone/miss",          benchZoneMiss },
+    { "monthStr",               benchMonthStr },
+    { "monthShortStr",          benchMonthShortStr },
+    { "dayStr",                 benchDayStr },
+    { "dayShortStr",            benchDayShortStr },
+    { "monthName",              benchMonthName },
+    { "monthFromName",          benchMonthFromName },
+    { "wheel/schedule+cancel",  benchWheelSchedule },
+    { "wheel/fire",             benchWheelFire },
+    { "cron/next",              benchCronNext },
+    { "cron/nextFirstMonday",   benchCronNextRare },
+    { "cron/fireTimes",         benchCronFireTimes },
+    { "codec/encode",           benchCodecEncode },
+    { "codec/decode",           benchCodecDecode },
+    { "codec/next",             benchCodecNext },
+    { "codec/seek",             benchCodecSeek },
+};
+
+// repeat with more operations until a run takes long enough to time reliably
+static void runBenchmark(const char* name, benchFunction run)
+{
+    typedef std::chrono::steady_clock clock;
+    uint32_t n = 1000;
+    for (;;) {
+        unsigned long allocationsBefore = allocations;
+        clock::time_point start = clock::now();
+        uint32_t ops = run(n);
+        double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+        if (ns > 100e6 || n >= 0x40000000) {
+            printf("%-26s %10.2f ns/op %8.3f allocs/op", name, ns / ops, (double)(allocations - allocationsBefore) / ops);
+            if (benchNote[0])
+                printf("   %s", benchNote);
+            printf("\n");
+            benchNote[0] = 0;
+            return;
+        }
+        n *= 2;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const char* filter = argc > 1 ? argv[1] : "";
+    setupSamples();
+    setupTexts();
+    setupLog();
+    setHostMillis(0);
+    TimeClass::setTime(times[0]);
+    for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+        if (strstr(benchmarks[i].name, filter))
+            runBenchmark(benchmarks[i].name, benchmarks[i].run);
+    }
+#ifdef TIME_STATS
+    printf("\n");
+    TimeClass::printTimeStats(Serial);
+#endif
+    return 0;
+}
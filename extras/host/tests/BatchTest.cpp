@@ -0,0 +1,128 @@
+/* BatchTest.cpp
+ * breakTimeBatch() and makeTimeBatch() against breakTime() and makeTime() element by element
+ *
+ * The Makefile builds this twice, with the kernel the CPU supports best and with the SSE2
+ * kernel (TIME_BATCH_NO_AVX2). Counts that are not a multiple of the vector width also
+ * exercise the scalar loop for the tail.
+ */
+
+#include <Arduino.h>
+#include <TimeLib.h>
+#include "HostTest.h"
+
+#define BATCH 1021  // not a multiple of 4 or 8
+
+static time_t times[BATCH];
+static time_t made[BATCH];
+static uint16_t years[BATCH];
+static uint8_t months[BATCH], days[BATCH], hours[BATCH], minutes[BATCH], seconds[BATCH], wdays[BATCH];
+static const tmColumns_t columns = { years, months, days, hours, minutes, seconds, wdays };
+
+static uint32_t seed = 1;
+
+static uint32_t nextRandom()
+{
+    seed = seed * 1664525 + 1013904223;
+    return seed;
+}
+
+static void checkBreak(size_t count)
+{
+    TimeClass::breakTimeBatch(times, count, columns);
+    for (size_t i = 0; i < count; i++) {
+        tm tme;
+        TimeClass::breakTime(times[i], tme);
+        bool same = years[i] == tmYearToCalendar(tme.tm_year) && months[i] == tme.tm_mon && days[i] == tme.tm_mday &&
+                    hours[i] == tme.tm_hour && minutes[i] == tme.tm_min && seconds[i] == tme.tm_sec &&
+                    wdays[i] == tme.tm_wday;
+        if (!CHECK(same))
+            printf("  breakTimeBatch differs for %lu\n", (unsigned long)times[i]);
+    }
+}
+
+static void checkMake(size_t count)
+{
+    TimeClass::makeTimeBatch(columns, count, made);
+    for (size_t i = 0; i < count; i++) {
+        tm tme = {};
+        tme.tm_year = CalendarYrToTm(years[i]);
+        tme.tm_mon = months[i];
+        tme.tm_mday = days[i];
+        tme.tm_hour = hours[i];
+        tme.tm_min = minutes[i];
+        tme.tm_sec = seconds[i];
+        if (!CHECK_EQ(made[i], TimeClass::makeTime(tme)))
+            printf("  for %u-%u-%u %u:%u:%u\n", years[i], months[i], days[i], hours[i], minutes[i], seconds[i]);
+    }
+}
+
+int main()
+{
+    // every day of the 32 bit range, at a different time of day each
+    size_t n = 0;
+    for (uint32_t day = 0; day <= 0xFFFFFFFFUL / SECS_PER_DAY; day++) {
+        uint64_t t = (uint64_t)day * SECS_PER_DAY + nextRandom() % SECS_PER_DAY;
+        times[n++] = t <= 0xFFFFFFFFUL ? (time_t)t : (time_t)0xFFFFFFFFUL;
+        if (n == BATCH) {
+            checkBreak(n);
+            n = 0;
+        }
+    }
+    checkBreak(n);
+    for (int round = 0; round < 1000; round++) {
+        for (size_t i = 0; i < BATCH; i++)
+            times[i] = nextRandom();
+        checkBreak(BATCH - round % 8);
+    }
+
+    // valid elements from the times broken down, then out of range months, days and times of day
+    for (int round = 0; round < 1000; round++) {
+        for (size_t i = 0; i < BATCH; i++)
+            times[i] = nextRandom();
+        TimeClass::breakTimeBatch(times, BATCH, columns);
+        checkMake(BATCH - round % 8);
+        CHECK(memcmp(made, times, sizeof(times) - round % 8 * sizeof(time_t)) == 0);
+    }
+    for (int round = 0; round < 2000; round++) {
+        for (size_t i = 0; i < BATCH; i++) {
+            uint32_t r = nextRandom();
+            years[i] = 1900 + r % 300;
+            months[i] = r >> 9;
+            days[i] = r >> 17;
+            r = nextRandom();
+            hours[i] = r;
+            minutes[i] = r >> 8;
+            seconds[i] = r >> 16;
+        }
+        checkMake(BATCH - round % 8);
+    }
+
+    // every month and day element in the years 0 and 1, where the leap year rule needs the year 0
+    // guard of makeTime(), and random elements over the whole range of the year column
+    n = 0;
+    for (uint32_t i = 0; i < 2 * 256 * 256; i++) {
+        years[n] = i >> 16;
+        months[n] = i >> 8;
+        days[n] = i;
+        hours[n] = minutes[n] = seconds[n] = 0;
+        if (++n == BATCH) {
+            checkMake(n);
+            n = 0;
+        }
+    }
+    checkMake(n);
+    for (int round = 0; round < 1000; round++) {
+        for (size_t i = 0; i < BATCH; i++) {
+            uint32_t r = nextRandom();
+            years[i] = r;
+            months[i] = r >> 16;
+            days[i] = r >> 24;
+            r = nextRandom();
+            hours[i] = r;
+            minutes[i] = r >> 8;
+            seconds[i] = r >> 16;
+        }
+        checkMake(BATCH - round % 8);
+    }
+    return testResult("batch");
+}
@@ -0,0 +1,94 @@
+/* BreakTimeTest.cpp
+ * breakTime() against the year by year and month by month loop it replaced
+ *
+ * Every day of the 32 bit range at several times of day, the last seconds of the range and
+ * pseudo random times.
+ */
+
+#include <Arduino.h>
+#include <TimeLib.h>
+#include "HostTest.h"
+
+#define LOOP_LEAP_YEAR(Y) ( ((1970+(Y))>0) && !((1970+(Y))%4) && ( ((1970+(Y))%100) || !((1970+(Y))%400) ) )
+
+static const uint8_t loopMonthDays[] = {31,28,31,30,31,30,31,31,30,31,30,31};
+
+// the implementation of breakTime() before the closed form days to civil conversion
+static void loopBreakTime(time_t timeInput, tm &tme)
+{
+    uint8_t year;
+    uint8_t month, monthLength;
+    uint32_t time;
+    unsigned long days;
+
+    time = (uint32_t)timeInput;
+    tme.tm_sec = time % 60;
+    time /= 60;
+    tme.tm_min = time % 60;
+    time /= 60;
+    tme.tm_hour = time % 24;
+    time /= 24;
+    tme.tm_wday = ((time + 4) % 7) + 1;
+
+    year = 0;
+    days = 0;
+    while ((unsigned)(days += (LOOP_LEAP_YEAR(year) ? 366 : 365)) <= time) {
+        year++;
+    }
+    tme.tm_year = year;
+
+    days -= LOOP_LEAP_YEAR(year) ? 366 : 365;
+    time -= days;
+
+    for (month = 0; month < 12; month++) {
+        if (month == 1) {
+            monthLength = LOOP_LEAP_YEAR(year) ? 29 : 28;
+        } else {
+            monthLength = loopMonthDays[month];
+        }
+        if (time >= monthLength) {
+            time -= monthLength;
+        } else {
+            break;
+        }
+    }
+    tme.tm_mon = month + 1;
+    tme.tm_mday = time + 1;
+}
+
+static bool checkTime(uint32_t t)
+{
+    tm expected = {}, actual = {};
+    loopBreakTime(t, expected);
+    TimeClass::breakTime(t, actual);
+    bool same = actual.tm_year == expected.tm_year && actual.tm_mon == expected.tm_mon &&
+                actual.tm_mday == expected.tm_mday && actual.tm_wday == expected.tm_wday &&
+                actual.tm_hour == expected.tm_hour && actual.tm_min == expected.tm_min &&
+                actual.tm_sec == expected.tm_sec;
+    if (!CHECK(same))
+        printf("  breakTime(%lu) gives %d-%d-%d %d %d:%d:%d, expected %d-%d-%d %d %d:%d:%d\n", (unsigned long)t,
+               actual.tm_year, actual.tm_mon, actual.tm_mday, actual.tm_wday, actual.tm_hour, actual.tm_min, actual.tm_sec,
+               expected.tm_year, expected.tm_mon, expected.tm_mday, expected.tm_wday, expected.tm_hour, expected.tm_min, expected.tm_sec);
+    return same;
+}
+
+int main()
+{
+    static const uint32_t timesOfDay[] = { 0, 1, 59, 3599, 43200, 86340, 86398, 86399 };
+    for (uint32_t day = 0; day <= 0xFFFFFFFFUL / SECS_PER_DAY; day++) {
+        for (uint32_t s : timesOfDay) {
+            uint64_t t = (uint64_t)day * SECS_PER_DAY + s;
+            if (t <= 0xFFFFFFFFUL)
+                checkTime((uint32_t)t);
+        }
+    }
+    for (uint32_t t = 0xFFFFFFFFUL - 200000; t != 0; t++)
+        checkTime(t);
+
+    uint32_t seed = 1;
+    for (int i = 0; i < 2000000; i++) {
+        seed = seed * 1664525 + 1013904223;
+        checkTime(seed);
+    }
+    return testResult("breakTime");
+}
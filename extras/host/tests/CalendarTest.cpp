@@ -0,0 +1,120 @@
+/* CalendarTest.cpp
+ * The calendarDate_t arithmetic and DateRange against a calendar counted one day at a time
+ *
+ * Every day from year 1 to 2500 is visited in order, and the day numbers, weekdays and days of
+ * the year are compared with the counted calendar, the ISO weeks with the C library's strftime()
+ * %G and %V. Month arithmetic is checked at random dates against its definition.
+ */
+
+#include <Arduino.h>
+#include <TimeLib.h>
+#include <time.h>
+#include "HostTest.h"
+
+static uint32_t seed = 1;
+
+static uint32_t nextRandom()
+{
+    seed = seed * 1664525 + 1013904223;
+    return seed;
+}
+
+// the ISO week year and week of a day number from the C library
+static void libcIsoWeek(long days, long& year, int& week)
+{
+    time_t t = (time_t)days * 86400;
+    struct tm tme;
+    gmtime_r(&t, &tme);
+    char text[16];
+    strftime(text, sizeof(text), "%G %V", &tme);
+    sscanf(text, "%ld %d", &year, &week);
+}
+
+int main()
+{
+    // every day, counted from Jan 1 of year 1, a Monday
+    long days = daysFromCivil(1, 1, 1);
+    int weekday = 2;
+    for (long year = 1; year <= 2500; year++) {
+        int yday = 1;
+        for (int month = 1; month <= 12; month++) {
+            for (int day = 1; day <= daysInMonth(year, month); day++, days++, yday++) {
+                calendarDate_t d = makeDate(year, month, day);
+                bool ok = CHECK_EQ(dateToDays(d), days) && CHECK_EQ(daysToDate(days), d) &&
+                          CHECK_EQ(dateWeekday(d), weekday) && CHECK_EQ(isoWeekday(d), (weekday + 5) % 7 + 1) &&
+                          CHECK_EQ(dayOfYear(d), yday);
+                if (year >= 1900 && year <= 2400) {
+                    long isoYear;
+                    int week;
+                    libcIsoWeek(days, isoYear, week);
+                    ok = ok && CHECK_EQ(isoWeekYear(d), isoYear) && CHECK_EQ(isoWeek(d), week);
+                }
+                if (!ok) {
+                    printf("  %ld-%02d-%02d\n", year, month, day);
+                    return testResult("calendar");
+                }
+                weekday = weekday % 7 + 1;
+            }
+        }
+        CHECK_EQ(yday - 1, isLeapYear(year) ? 366 : 365);
+    }
+
+    // ISO week 53 in the years that have one: those starting on a Thursday, or leap years on a Wednesday
+    int longYears = 0;
+    for (long year = 2000; year < 2400; year++) {
+        int first = isoWeekday(makeDate(year, 1, 1));
+        bool has53 = first == 4 || (first == 3 && isLeapYear(year));
+        CHECK_EQ(isoWeek(makeDate(year, 12, 28)), has53 ? 53 : 52);
+        longYears += has53;
+    }
+    CHECK_EQ(longYears, 71);  // in every 400 years
+
+    // month arithmetic: the same day in the new month, or its last day, and whole months between
+    for (int i = 0; i < 200000; i++) {
+        calendarDate_t a = daysToDate(daysFromCivil(1900, 1, 1) + nextRandom() % 146097);
+        long months = (long)(nextRandom() % 4001) - 2000;
+        calendarDate_t b = addMonths(a, months);
+        long index = monthIndex(a) + months;
+        int length = daysInMonth(index / 12, index % 12 + 1);
+        if (!CHECK_EQ(dateYear(b), index / 12) || !CHECK_EQ(dateMonth(b), index % 12 + 1) ||
+            !CHECK_EQ(dateDay(b), dateDay(a) < length ? dateDay(a) : length)) {
+            printf("  %ld-%02d-%02d plus %ld months\n", dateYear(a), dateMonth(a), dateDay(a), months);
+            break;
+        }
+        CHECK_EQ(addYears(a, months), addMonths(a, months * 12));
+
+        // addMonths(a, n) does not pass c, and n + 1 months in the same direction would
+        calendarDate_t c = addDays(b, (long)(nextRandom() % 61) - 30);
+        long n = monthsBetween(a, c);
+        if (c >= a) {
+            CHECK(n >= 0 && addMonths(a, n) <= c && addMonths(a, n + 1) > c);
+        } else {
+            CHECK(n <= 0 && addMonths(a, n) >= c && addMonths(a, n - 1) < c);
+        }
+        CHECK_EQ(yearsBetween(a, c), n / 12);
+        CHECK_EQ(daysBetween(a, c), dateToDays(c) - dateToDays(a));
+    }
+
+    // DateRange steps through month and year ends and leap days as addDays() does
+    calendarDate_t first = makeDate(1999, 12, 1), last = makeDate(2001, 3, 2);
+    DateRange range(first, last);
+    long count = 0;
+    calendarDate_t expected = first;
+    for (calendarDate_t d : range) {
+        if (!CHECK_EQ(d, expected))
+            break;
+        expected = addDays(expected, 1);
+        count++;
+    }
+    CHECK_EQ(count, range.days());
+    CHECK_EQ(count, daysBetween(first, last));
+    CHECK_EQ(DateRange(last, first).days(), 0);
+    count = 0;
+    for (calendarDate_t d : DateRange(last, first)) {
+        (void)d;
+        count++;
+    }
+    CHECK_EQ(count, 0);
+
+    return testResult("calendar");
+}
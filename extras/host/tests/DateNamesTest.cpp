@@ -0,0 +1,75 @@
+/* DateNamesTest.cpp
+ * monthFromName() and dayFromName() with the English table computed ahead and with tables
+ * built by setDateLocale()
+ */
+
+#include <Arduino.h>
+#include <TimeLib.h>
+#include <ctype.h>
+#include "HostTest.h"
+
+static const char* const frenchMonths[] = { "", "janvier", "février", "mars", "avril", "mai", "juin",
+    "juillet", "août", "septembre", "octobre", "novembre", "décembre" };
+static const char* const frenchMonthsShort[] = { "", "janv", "févr", "mars", "avr", "mai", "juin",
+    "juil", "août", "sept", "oct", "nov", "déc" };
+static const char* const frenchDays[] = { "", "dimanche", "lundi", "mardi", "mercredi", "jeudi", "vendredi", "samedi" };
+static const char* const frenchDaysShort[] = { "", "dim", "lun", "mar", "mer", "jeu", "ven", "sam" };
+static const dateLocale_t french = { frenchMonths, frenchMonthsShort, frenchDays, frenchDaysShort };
+
+static uint8_t monthFrom(const char* name)
+{
+    return TimeClass::monthFromName(name, strlen(name));
+}
+
+static uint8_t dayFrom(const char* name)
+{
+    return TimeClass::dayFromName(name, strlen(name));
+}
+
+// every name of the current locale, as it is and in upper case
+static void checkNames()
+{
+    for (uint8_t i = 1; i <= 12; i++) {
+        dateName_t names[2] = { TimeClass::monthName(i), TimeClass::monthShortName(i) };
+        for (dateName_t name : names) {
+            char text[32];
+            memcpy(text, name.text, name.length);
+            text[name.length] = 0;
+            CHECK_EQ(monthFrom(text), i);
+            for (char* p = text; *p; p++)
+                *p = toupper((unsigned char)*p);
+            CHECK_EQ(monthFrom(text), i);
+        }
+    }
+    for (uint8_t i = 1; i <= 7; i++) {
+        dateName_t names[2] = { TimeClass::dayName(i), TimeClass::dayShortName(i) };
+        for (dateName_t name : names) {
+            CHECK_EQ(TimeClass::dayFromName(name.text, name.length), i);
+            CHECK_EQ(TimeClass::monthFromName(name.text, name.length), 0);
+        }
+    }
+}
+
+int main()
+{
+    // before setDateLocale() is ever called
+    checkNames();
+    CHECK_EQ(monthFrom("sep"), 9);
+    CHECK_EQ(monthFrom("Septembe"), 0);
+    CHECK_EQ(monthFrom("Mayo"), 0);
+    CHECK_EQ(monthFrom("Monday"), 0);
+    CHECK_EQ(dayFrom("TUE"), 3);
+    CHECK_EQ(dayFrom("January"), 0);
+    CHECK_EQ(monthFrom(""), 0);
+
+    TimeClass::setDateLocale(&french);
+    checkNames();
+    CHECK_EQ(monthFrom("janvier"), 1);
+    CHECK_EQ(monthFrom("January"), 0);
+    CHECK_EQ(dayFrom("mar"), 3);
+
+    TimeClass::setDateLocale(NULL);
+    checkNames();
+    CHECK_EQ(monthFrom("janvier"), 0);
+    return testResult("date names");
+}
@@ -0,0 +1,133 @@
+/* DateTimeTest.cpp
+ * DateTime elements, arithmetic and ISO 8601 output
+ *
+ * The elements at random times and offsets are compared with the C library's gmtime_r() of the
+ * local time, and the ISO text with strftime() followed by the offset written by hand, so the
+ * offsets west of UTC and those of less than an hour are covered.
+ */
+
+#include <Arduino.h>
+#include <TimeLib.h>
+#include <string.h>
+#include <time.h>
+#include "HostTest.h"
+
+static uint32_t seed = 1;
+
+static uint32_t nextRandom()
+{
+    seed = seed * 1664525 + 1013904223;
+    return seed;
+}
+
+static const long offsets[] = { 0, 1800, -1800, 3600, -3600, 20700, -34200, 50400, -43200, -59, 59 };
+
+// the ISO text from the C library, with the offset as +hh:mm, in whole minutes towards zero
+static void libcIso(time_t t, long offset, char* text, size_t size)
+{
+    time_t local = t + offset;
+    struct tm tme;
+    gmtime_r(&local, &tme);
+    size_t n = strftime(text, size, "%Y-%m-%dT%H:%M:%S", &tme);
+    long minutes = (offset < 0 ? -offset : offset) / 60;
+    if (offset == 0)
+        snprintf(text + n, size - n, "Z");
+    else
+        snprintf(text + n, size - n, "%c%02ld:%02ld", offset < 0 ? '-' : '+', minutes / 60, minutes % 60);
+}
+
+int main()
+{
+    for (int i = 0; i < 200000; i++) {
+        long offset = offsets[i % (sizeof(offsets) / sizeof(offsets[0]))];
+        time_t t = 30 * 86400 + nextRandom() % (0xFFFFFFFFu - 60 * 86400);  // room for the days added
+        DateTime dt(t, offset);
+
+        time_t local = t + offset;
+        struct tm tme;
+        gmtime_r(&local, &tme);
+        bool ok = CHECK_EQ(dt.time(), t) && CHECK_EQ(dt.localTime(), local) && CHECK_EQ(dt.offset(), offset) &&
+                  CHECK_EQ(dt.year(), tme.tm_year + 1900) && CHECK_EQ(dt.month(), tme.tm_mon + 1) &&
+                  CHECK_EQ(dt.day(), tme.tm_mday) && CHECK_EQ(dt.hour(), tme.tm_hour) &&
+                  CHECK_EQ(dt.minute(), tme.tm_min) && CHECK_EQ(dt.second(), tme.tm_sec) &&
+                  CHECK_EQ(dt.weekday(), tme.tm_wday + 1) &&
+                  CHECK_EQ(dt.hourFormat12(), tme.tm_hour % 12 == 0 ? 12 : tme.tm_hour % 12) &&
+                  CHECK_EQ(dt.isPM(), tme.tm_hour >= 12) &&
+                  CHECK_EQ(dt.date(), makeDate(tme.tm_year + 1900, tme.tm_mon + 1, tme.tm_mday)) &&
+                  CHECK_EQ(dt.secondOfDay(), tme.tm_hour * 3600L + tme.tm_min * 60 + tme.tm_sec);
+
+        char text[DATE_TIME_ISO_SIZE], expected[40];
+        libcIso(t, offset, expected, sizeof(expected));
+        size_t length = dt.formatTo(text, sizeof(text));
+        ok = ok && CHECK_EQ(length, strlen(expected)) && CHECK(strcmp(text, expected) == 0);
+        if (!ok) {
+            printf("  %lld at %ld: \"%s\", expected \"%s\"\n", (long long)t, offset, text, expected);
+            break;
+        }
+
+        // the same instant at another offset, and back from the local elements
+        DateTime other = dt.withOffset(offsets[(i + 3) % (sizeof(offsets) / sizeof(offsets[0]))]);
+        CHECK(other == dt && !(other != dt) && other <= dt && other >= dt);
+        CHECK_EQ(DateTime::fromLocal(dt.year(), dt.month(), dt.day(), dt.hour(), dt.minute(), dt.second(), offset).time(), t);
+
+        // arithmetic keeps the offset and the wall clock time
+        long seconds = (long)(nextRandom() % 200000) - 100000;
+        DateTime moved = dt + seconds;
+        CHECK_EQ(moved.time(), t + seconds);
+        CHECK_EQ(moved - dt, seconds);
+        CHECK_EQ((dt - seconds).time(), t - seconds);
+        CHECK(seconds > 0 ? (moved > dt && dt < moved) : seconds < 0 ? (moved < dt && dt > moved) : moved == dt);
+        long days = (long)(nextRandom() % 41) - 20;
+        DateTime later = dt.addDays(days);
+        CHECK_EQ(later.date(), addDays(dt.date(), days));
+        CHECK_EQ(later.secondOfDay(), dt.secondOfDay());
+        CHECK_EQ(later.offset(), offset);
+        long months = (long)(nextRandom() % 25) - 12;
+        if (dt.year() > 1971 && dt.year() < 2105) {
+            DateTime shifted = dt.addMonths(months);
+            CHECK_EQ(shifted.date(), addMonths(dt.date(), months));
+            CHECK_EQ(shifted.secondOfDay(), dt.secondOfDay());
+            CHECK_EQ(shifted.offset(), offset);
+            CHECK_EQ(dt.addYears(1).date(), addYears(dt.date(), 1));
+        }
+    }
+
+    // the offsets of less than an hour either side, and the ends of the range
+    char text[DATE_TIME_ISO_SIZE];
+    DateTime(1700000000, -1800).formatTo(text, sizeof(text));
+    CHECK(strcmp(text, "2023-11-14T21:43:20-00:30") == 0);
+    DateTime(1700000000, 1800).formatTo(text, sizeof(text));
+    CHECK(strcmp(text, "2023-11-14T22:43:20+00:30") == 0);
+    DateTime(1700000000, -34200).formatTo(text, sizeof(text));
+    CHECK(strcmp(text, "2023-11-14T12:43:20-09:30") == 0);
+    DateTime(1700000000, 20700).formatTo(text, sizeof(text));
+    CHECK(strcmp(text, "2023-11-15T03:58:20+05:45") == 0);
+    DateTime(0).formatTo(text, sizeof(text));
+    CHECK(strcmp(text, "1970-01-01T00:00:00Z") == 0);
+    DateTime(0xFFFFFFFF).formatTo(text, sizeof(text));
+    CHECK(strcmp(text, "2106-02-07T06:28:15Z") == 0);
+
+    // cut as snprintf() does, with the length of the whole text
+    char small[11];
+    CHECK_EQ(DateTime(1700000000, -1800).formatTo(small, sizeof(small)), 25);
+    CHECK(strcmp(small, "2023-11-14") == 0);
+    CHECK_EQ(DateTime(1700000000).formatTo(small, 0), 20);
+
+    // clamped to the end of a shorter month, keeping the time of day
+    DateTime endOfJanuary = DateTime::fromLocal(2023, 1, 31, 22, 30, 0, -1800);
+    CHECK_EQ(endOfJanuary.addMonths(1).date(), makeDate(2023, 2, 28));
+    CHECK_EQ(endOfJanuary.addMonths(1).hour(), 22);
+    CHECK_EQ(DateTime::fromLocal(2024, 2, 29, 12).addYears(1).date(), makeDate(2025, 2, 28));
+
+    // in a zone, adding days keeps the offset and inZone() takes the one in effect then
+    TimeZone cet("CET-1CEST,M3.5.0,M10.5.0/3");
+    DateTime winter = DateTime::fromLocal(2023, 3, 25, 12, 0, 0, cet);
+    CHECK_EQ(winter.offset(), 3600);
+    DateTime next = winter.addDays(1);
+    CHECK_EQ(next.offset(), 3600);
+    CHECK_EQ(next.inZone(cet).offset(), 7200);
+    CHECK_EQ(next.inZone(cet).hour(), 13);
+    CHECK_EQ(DateTime::fromLocal(2023, 3, 26, 12, 0, 0, cet) - winter, 86400 - 3600);
+
+    return testResult("date time");
+}
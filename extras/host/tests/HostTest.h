@@ -0,0 +1,45 @@
+/* HostTest.h
+ * Checks shared by the host tests of the Time library, see the test target of the Makefile
+ *
+ * Each test is a program of its own, so the clock and the other state of the library start
+ * fresh. A failed check prints where it failed and the values compared; the program exits
+ * with 1 if any check failed. Only the first failures are printed.
+ */
+
+#ifndef _Host_Test_h
+#define _Host_Test_h
+
+#include <stdio.h>
+
+static unsigned long testChecks = 0;
+static unsigned long testFailures = 0;
+
+static inline bool checkFailed(const char* file, int line, const char* expr)
+{
+    if (++testFailures <= 20)
+        printf("%s:%d: check failed: %s\n", file, line, expr);
+    return false;
+}
+
+static inline bool checkEqual(long long actual, long long expected, const char* file, int line, const char* expr)
+{
+    testChecks++;
+    if (actual == expected)
+        return true;
+    if (testFailures < 20)
+        printf("%s:%d: %s is %lld, expected %lld\n", file, line, expr, actual, expected);
+    testFailures++;
+    return false;
+}
+
+#define CHECK(cond) (testChecks++, (cond) ? true : checkFailed(__FILE__, __LINE__, #cond))
+#define CHECK_EQ(actual, expected) checkEqual((long long)(actual), (long long)(expected), __FILE__, __LINE__, #actual)
+
+// the exit status of the test program
+static inline int testResult(const char* name)
+{
+    printf("%s: %lu checks, %lu failed\n", name, testChecks, testFailures);
+    return testFailures == 0 ? 0 : 1;
+}
+
+#endif /* _Host_Test_h */
@@ -0,0 +1,140 @@
+/* ParseTimeTest.cpp
+ * parseTime() and parseTimeMs() reading back what the library writes, and refusing the rest
+ *
+ * Random times are written with TimeFormat, DateTime and timeStr() and parsed again. Every
+ * byte of the fixed 19 character layout is replaced by every other byte, so the SWAR checks of
+ * the digits and separators are compared with a test of one character at a time.
+ */
+
+#include <Arduino.h>
+#include <TimeLib.h>
+#include <string.h>
+#include "HostTest.h"
+
+static uint32_t seed = 1;
+
+static uint32_t nextRandom()
+{
+    seed = seed * 1664525 + 1013904223;
+    return seed;
+}
+
+static bool checkParse(const char* text, size_t expectedUsed, time_ms_t expected)
+{
+    time_ms_t t = 0;
+    size_t used = Time.parseTimeMs(text, strlen(text), t);
+    if (CHECK_EQ(used, expectedUsed) && (used == 0 || CHECK_EQ(t, expected)))
+        return true;
+    printf("  \"%s\"\n", text);
+    return false;
+}
+
+// what the layout "YYYY-MM-DDThh:mm:ss" allows at i, one character at a time
+static bool allowed(int i, char c)
+{
+    if (i == 4 || i == 7)
+        return c == '-';
+    if (i == 10)
+        return c == 'T' || c == 't' || c == ' ';
+    if (i == 13 || i == 16)
+        return c == ':';
+    return c >= '0' && c <= '9';
+}
+
+int main()
+{
+    // round trips through the formats the library writes, with offsets under an hour either side
+    static const long offsets[] = { 0, 3600, -3600, 1800, -1800, 19800, -34200, 50400, -43200 };
+    TimeFormat iso(TIME_FORMAT_ISO8601_FULL);
+    char text[64];
+    for (int i = 0; i < 50000; i++) {
+        uint32_t t = nextRandom();
+        long offset = offsets[i % (sizeof(offsets) / sizeof(offsets[0]))];
+        if ((int64_t)t + offset < 0 || (int64_t)t + offset > 0xFFFFFFFFLL)
+            continue;
+        iso.formatTo(text, sizeof(text), t + offset, offset);
+        if (!checkParse(text, strlen(text), (time_ms_t)t * 1000))
+            break;
+        DateTime dt(t, offset);
+        dt.formatTo(text, sizeof(text));
+        if (!checkParse(text, strlen(text), (time_ms_t)t * 1000))
+            break;
+        String asctime = Time.timeStr(t);  // in the zone, UTC here
+        if (!checkParse(asctime.c_str(), 24, (time_ms_t)t * 1000))
+            break;
+    }
+
+    // %z takes its sign from the offset, so an offset under an hour west reads back as west
+    iso.formatTo(text, sizeof(text), 1700000000 - 1800, -1800);
+    CHECK(strcmp(text, "2023-11-14T21:43:20-00:30") == 0);
+    checkParse(text, 25, 1700000000000ULL);
+
+    // the fraction, the date alone, local time and the other forms of the offset
+    checkParse("2023-11-14T22:13:20.250Z", 24, 1700000000250ULL);
+    checkParse("2023-11-14t22:13:20.1z", 22, 1700000000100ULL);
+    checkParse("2023-11-14 22:13:20.123456+00:00", 32, 1700000000123ULL);
+    checkParse("2023-11-14T23:13:20+0100", 24, 1700000000000ULL);
+    checkParse("2023-11-14T23:13:20+01", 22, 1700000000000ULL);
+    checkParse("2023-11-14T22:13:20", 19, 1700000000000ULL);
+    checkParse("2023-11-14T22:13:20 and more", 19, 1700000000000ULL);
+    checkParse("2023-11-14", 10, 1699920000000ULL);
+    checkParse("2016-12-31T23:59:60Z", 20, 1483228800000ULL);  // a leap second
+    checkParse("1970-01-01T00:00:00Z", 20, 0);
+    checkParse("2106-02-07T06:28:15Z", 20, 4294967295000ULL);
+    checkParse("Tue Nov 14 22:13:20 2023", 24, 1700000000000ULL);
+    checkParse("Thu Jan  1 00:00:00 1970", 24, 0);
+
+    // malformed or out of range
+    static const char* const malformed[] = {
+        "", "2023", "2023-11-1", "2023-11-14T", "2023-11-14T22:13", "2023-11-14T22:13:2",
+        "2023-13-14T22:13:20Z", "2023-00-14", "2023-02-29", "2024-02-30", "2023-11-14T24:00:00Z",
+        "2023-11-14T22:60:00Z", "2023-11-14T22:13:61Z", "2023-11-14T22:13:20.Z",
+        "2023-11-14T22:13:20+24:00", "2023-11-14T22:13:20+01:60", "2023-11-14T22:13:20+01:",
+        "1969-12-31T23:59:59Z", "2106-02-07T06:28:16Z", "2106-02-07T06:28:15-00:01",
+        "1970-01-01T00:00:00+00:01", "Wed Nov 14 22:13:20 2023", "Tue Nov 14 22:13:20 202",
+        "Tue Nov 31 22:13:20 2023", "Tue Xyz 14 22:13:20 2023", "tue Nov 14 22:13:20 2023",
+    };
+    for (size_t i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++) {
+        checkParse(malformed[i], 0, 0);
+    }
+    time_t seconds = 7;
+    CHECK_EQ(Time.parseTime(NULL, 10, seconds), 0);
+    CHECK_EQ(Time.parseTime("2023-11-14", 9, seconds), 0);  // the length is kept to
+    CHECK_EQ(seconds, 7);
+
+    // every byte at every place of the fixed layout, with both separators
+    static const char* const valid[] = { "2023-11-14T22:13:20Z", "2023-11-14 22:13:20Z" };
+    for (size_t v = 0; v < 2; v++) {
+        for (int i = 0; i < 19; i++) {
+            for (int c = 1; c < 256; c++) {
+                char s[24];
+                strcpy(s, valid[v]);
+                if (s[i] == (char)c)
+                    continue;
+                s[i] = (char)c;
+                time_ms_t t = 0;
+                size_t used = Time.parseTimeMs(s, strlen(s), t);
+                if (allowed(i, (char)c)) {
+                    // another date or time, which may not exist
+                    CHECK(used == 0 || used == 20);
+                } else if (i > 10 || (i == 10 && c != 'T' && c != 't')) {
+                    // the time is broken: the date alone unless a time was started with T
+                    size_t expected = (s[10] == 'T' || s[10] == 't') ? 0 : 10;
+                    if (!CHECK_EQ(used, expected))
+                        printf("  \"%s\"\n", s);
+                } else if (!CHECK_EQ(used, 0)) {
+                    printf("  \"%s\"\n", s);
+                }
+            }
+        }
+    }
+
+    // without an offset the time is local in the time zone
+    CHECK(Time.setTimeZone("CET-1CEST,M3.5.0,M10.5.0/3"));
+    checkParse("2023-11-14T23:13:20", 19, 1700000000000ULL);
+    checkParse("2023-07-01T02:00:00", 19, 1688169600000ULL);
+    checkParse("Tue Nov 14 23:13:20 2023", 24, 1700000000000ULL);
+    checkParse("2023-11-14T22:13:20Z", 20, 1700000000000ULL);
+
+    return testResult("parse");
+}
@@ -0,0 +1,117 @@
+/* SnapshotTest.cpp
+ * Saving the clock through the file backed snapshot storage and restoring it at a fresh start
+ *
+ * The clock that saves runs in a child process, so the parent restores into a clock that was
+ * never set, as after a reset.
+ */
+
+#include <Arduino.h>
+#include <TimeLib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "HostTest.h"
+#include "SnapshotFile.h"
+
+static const char* path = "build/tests/SnapshotTest.snapshot";
+
+static time_t provided = 0;
+static time_t provider() { return provided; }
+
+static int saves = 0;
+static timeSnapshot_t saved;
+
+static bool save(const timeSnapshot_t& snapshot)
+{
+    saves++;
+    saved = snapshot;
+    return saveSnapshotFile(snapshot);
+}
+
+// the run before the reset: synced, adjusted by hand, then running without a provider
+static void runBefore()
+{
+    setHostMillis(0);
+    TimeClass::setSnapshotStorage(save, loadSnapshotFile, 600);
+    CHECK(!TimeClass::saveSnapshot());  // the time is not set
+    provided = 1700000000;
+    TimeClass::setSyncProvider(provider);
+    CHECK_EQ(saves, 1);  // right after the first sync
+    CHECK_EQ(saved.time, 1700000000000LL);
+    CHECK_EQ(saved.status, timeSet);
+    CHECK_EQ(saved.uncertaintyMs, 999);
+
+    // a step by hand is saved by the next update
+    advanceHostMillis(10000);
+    TimeClass::adjustTime(30);
+    TimeClass::now();
+    CHECK_EQ(saves, 2);
+    CHECK_EQ(saved.time, 1700000040000LL);
+    TimeClass::adjustTimeMs(-250);
+    TimeClass::now();
+    CHECK_EQ(saves, 3);
+    CHECK_EQ(saved.time, 1700000039750LL);
+
+    // every interval
+    TimeClass::setSyncProvider(0);
+    advanceHostMillis(599000);
+    TimeClass::now();
+    CHECK_EQ(saves, 3);
+    advanceHostMillis(1000);
+    TimeClass::now();
+    CHECK_EQ(saves, 4);
+    CHECK_EQ(saved.syncAge, 610);  // a step by hand does not age it
+    CHECK(TimeClass::saveSnapshot());
+    CHECK_EQ(saves, 5);
+}
+
+int main()
+{
+    setSnapshotFile(path);
+    remove(path);
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) {
+        runBefore();
+        return testResult("snapshot save");
+    }
+    int status = 0;
+    CHECK(child > 0 && waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    // a damaged snapshot is not restored
+    setHostMillis(0);
+    TimeClass::setSnapshotStorage(saveSnapshotFile, loadSnapshotFile, 600);
+    timeSnapshot_t good;
+    CHECK(loadSnapshotFile(good));
+    timeSnapshot_t damaged = good;
+    ((uint8_t*)&damaged)[9] ^= 0x55;
+    CHECK(saveSnapshotFile(damaged));
+    CHECK(!TimeClass::restoreSnapshot());
+    damaged = good;
+    damaged.version++;
+    damaged.check = good.check;
+    CHECK(saveSnapshotFile(damaged));
+    CHECK(!TimeClass::restoreSnapshot());
+    CHECK_EQ(TimeClass::timeStatus(), timeNotSet);
+    CHECK_EQ(TimeClass::timeUncertaintyMs(), 0xFFFFFFFFUL);
+    CHECK(saveSnapshotFile(good));
+
+    // restored half a save interval after the snapshot, plus the time the device was off
+    CHECK(TimeClass::restoreSnapshot(60, 2000));
+    CHECK_EQ(TimeClass::timeStatus(), timeEstimated);
+    CHECK_EQ(TimeClass::nowMs(), 1700000639750LL + (60 + 300) * 1000);
+    // 999 at the sync, 100 ppm of the 610 seconds since and the interval, half the interval, the time off
+    CHECK_EQ(TimeClass::timeUncertaintyMs(), 999 + 121 + 300000 + 2000);
+    CHECK(!TimeClass::restoreSnapshot());  // the time is already set
+
+    // a failed sync leaves it estimated, the first good one sets it
+    TimeClass::setSyncProvider(provider);
+    CHECK_EQ(TimeClass::timeStatus(), timeEstimated);
+    provided = 1700001500;
+    TimeClass::setSyncProvider(provider);
+    CHECK_EQ(TimeClass::timeStatus(), timeSet);
+    CHECK_EQ(TimeClass::now(), 1700001500);
+    CHECK_EQ(TimeClass::timeUncertaintyMs(), 999);
+
+    remove(path);
+    return testResult("snapshot restore");
+}
@@ -0,0 +1,126 @@
+/* SyncTest.cpp
+ * The asynchronous sync driven by a fake provider and the fake millis() of the host build
+ *
+ * The provider only counts the requests; the test answers them with syncComplete() or
+ * syncFailed(), or lets them time out, and checks what timeStatus() and syncStatus() show.
+ */
+
+#include <Arduino.h>
+#include <TimeLib.h>
+#include "HostTest.h"
+
+static int requests = 0;
+static time_t answerAtOnce = 0;  // answered from inside the request when set
+
+static void requestTime()
+{
+    requests++;
+    if (answerAtOnce != 0)
+        TimeClass::syncComplete(answerAtOnce);
+}
+
+// advance the fake clock a second at a time, as a sketch calling now() in loop() would see it
+static void runSeconds(uint32_t seconds)
+{
+    for (uint32_t i = 0; i < seconds; i++) {
+        advanceHostMillis(1000);
+        TimeClass::now();
+    }
+}
+
+// seconds until the next request is made, 0 if none is made in 10 minutes
+static uint32_t runUntilRequest()
+{
+    int made = requests;
+    for (uint32_t seconds = 1; seconds <= 600; seconds++) {
+        runSeconds(1);
+        if (requests != made)
+            return seconds;
+    }
+    return 0;
+}
+
+int main()
+{
+    setHostMillis(0);
+
+    // the first request is made at once and nothing blocks while it is pending
+    TimeClass::setSyncRequest(requestTime, 1500);
+    CHECK_EQ(requests, 1);
+    CHECK_EQ(TimeClass::syncStatus(), syncPending);
+    CHECK_EQ(TimeClass::timeStatus(), timeNotSet);
+    advanceHostMillis(1499);
+    CHECK_EQ(TimeClass::timeStatus(), timeNotSet);
+    CHECK_EQ(TimeClass::syncStatus(), syncPending);
+    CHECK_EQ(requests, 1);
+
+    // a failure before the time was ever set leaves it not set
+    advanceHostMillis(1);
+    CHECK_EQ(TimeClass::timeStatus(), timeNotSet);
+    CHECK_EQ(TimeClass::syncStatus(), syncBackoff);
+    CHECK_EQ(runUntilRequest(), 1);
+    CHECK_EQ(TimeClass::syncStatus(), syncPending);
+
+    // the answer sets the clock
+    CHECK(TimeClass::syncComplete(1700000000));
+    CHECK_EQ(TimeClass::syncStatus(), syncIdle);
+    CHECK_EQ(TimeClass::timeStatus(), timeSet);
+    CHECK_EQ(TimeClass::now(), 1700000000);
+    CHECK(!TimeClass::syncComplete(1700000000));  // nothing is pending
+
+    // the next request when the sync interval is up
+    TimeClass::setSyncInterval(60);
+    runSeconds(59);
+    CHECK_EQ(requests, 2);
+    runSeconds(1);
+    CHECK_EQ(requests, 3);
+    CHECK_EQ(TimeClass::syncStatus(), syncPending);
+    CHECK_EQ(TimeClass::timeStatus(), timeSet);
+
+    // a timeout is a failure, the time is kept but needs a sync, and a late answer is ignored
+    advanceHostMillis(1499);
+    CHECK_EQ(TimeClass::syncStatus(), syncPending);
+    advanceHostMillis(1);
+    CHECK_EQ(TimeClass::syncStatus(), syncBackoff);
+    CHECK_EQ(TimeClass::timeStatus(), timeNeedsSync);
+    CHECK_EQ(TimeClass::syncFailures(), 1);
+    time_t before = TimeClass::now();
+    CHECK(!TimeClass::syncComplete(1800000000));
+    CHECK_EQ(TimeClass::now(), before);
+
+    // retries after 1, 2, 4 ... seconds up to the sync interval, failed by syncFailed() from here on
+    static const uint32_t backoff[] = { 1, 2, 4, 8, 16, 32, 60, 60 };
+    for (uint32_t wait : backoff) {
+        CHECK_EQ(runUntilRequest(), wait);
+        CHECK_EQ(TimeClass::syncStatus(), syncPending);
+        CHECK_EQ(TimeClass::timeStatus(), timeNeedsSync);
+        TimeClass::syncFailed();
+        CHECK_EQ(TimeClass::syncStatus(), syncBackoff);
+    }
+    CHECK_EQ(TimeClass::syncFailures(), 9);
+    TimeClass::syncFailed();  // nothing is pending
+    CHECK_EQ(TimeClass::syncFailures(), 9);
+
+    // an answer ends the backoff
+    CHECK_EQ(runUntilRequest(), 60);
+    CHECK(TimeClass::syncCompleteMs(1700001000250LL));
+    CHECK_EQ(TimeClass::syncStatus(), syncIdle);
+    CHECK_EQ(TimeClass::timeStatus(), timeSet);
+    CHECK_EQ(TimeClass::syncFailures(), 0);
+    CHECK_EQ(TimeClass::nowMs(), 1700001000250LL);
+
+    // a request answered from inside the request function
+    answerAtOnce = 1700002000;
+    CHECK_EQ(runUntilRequest(), 60);
+    CHECK_EQ(TimeClass::syncStatus(), syncIdle);
+    CHECK_EQ(TimeClass::timeStatus(), timeSet);
+    CHECK_EQ(TimeClass::now(), 1700002000);
+
+    // a time of 0 is a failure
+    answerAtOnce = 0;
+    CHECK_EQ(runUntilRequest(), 60);
+    CHECK(!TimeClass::syncComplete(0));
+    CHECK_EQ(TimeClass::syncStatus(), syncBackoff);
+    CHECK_EQ(TimeClass::timeStatus(), timeNeedsSync);
+    return testResult("sync");
+}
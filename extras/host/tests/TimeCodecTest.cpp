@@ -0,0 +1,190 @@
+/* TimeCodecTest.cpp
+ * TimeEncoder and TimeDecoder round trips, keyframes, seeking and damaged streams
+ *
+ * Streams of regular, jittered, backward and widely jumping times are encoded and read back
+ * with nextMs(), decode() and the one byte fast path of decodeMs(), which must all agree. seekMs()
+ * is compared with a linear search, and cut or corrupted data must stop the decoder cleanly.
+ */
+
+#include <Arduino.h>
+#include <TimeLib.h>
+#include <string.h>
+#include "HostTest.h"
+
+#define COUNT 3000
+
+static uint32_t seed = 1;
+
+static uint32_t nextRandom()
+{
+    seed = seed * 1664525 + 1013904223;
+    return seed;
+}
+
+static time_ms_t times[COUNT];
+static uint8_t data[COUNT * TIME_CODEC_MAX_RECORD];
+static size_t ends[COUNT];  // where each record ends in data
+
+// a stream in one of several shapes, increasing unless backwards is set
+static void makeTimes(int shape, bool backwards)
+{
+    time_ms_t t = 1700000000000ULL + nextRandom() % 100000;
+    for (int i = 0; i < COUNT; i++) {
+        uint32_t r = nextRandom();
+        switch (shape) {
+        case 0: t += 1000; break;                              // steady
+        case 1: t += 250 + (r >> 8) % 40; break;               // jitter
+        case 2: t += (r >> 8) % 8 == 0 ? 3600000 : 10; break;  // bursts and long gaps
+        default: t += (time_ms_t)(r >> 8) * 37; break;         // anything up to a week
+        }
+        if (backwards && (r & 0x1F) == 0 && t > 5000000)
+            t -= 5000000;
+        times[i] = t;
+    }
+}
+
+static size_t encodeAll(TimeEncoder& encoder, bool milliseconds)
+{
+    size_t length = 0;
+    for (int i = 0; i < COUNT; i++) {
+        size_t n = milliseconds ? encoder.encodeMs(times[i], data + length, sizeof(data) - length)
+                                : encoder.encode((time_t)(times[i] / 1000), data + length, sizeof(data) - length);
+        CHECK(n >= 1 && n <= TIME_CODEC_MAX_RECORD);
+        length += n;
+        ends[i] = length;
+    }
+    return length;
+}
+
+static time_ms_t expected(int i, bool milliseconds)
+{
+    return milliseconds ? times[i] : times[i] / 1000 * 1000;
+}
+
+static void checkStream(int shape, bool milliseconds, uint16_t interval, bool backwards)
+{
+    makeTimes(shape, backwards);
+    TimeEncoder encoder(milliseconds, interval);
+    size_t length = encodeAll(encoder, milliseconds);
+
+    // nextMs() and decodeMs() in uneven blocks give the same times
+    TimeDecoder one(data, length);
+    TimeDecoder block(data, length);
+    time_ms_t buf[37];
+    int i = 0;
+    while (i < COUNT) {
+        size_t n = block.decodeMs(buf, 1 + nextRandom() % 37);
+        if (!CHECK(n > 0))
+            break;
+        for (size_t j = 0; j < n && i < COUNT; j++, i++) {
+            time_ms_t t;
+            CHECK(one.nextMs(t));
+            if (!CHECK_EQ(t, expected(i, milliseconds)) || !CHECK_EQ(buf[j], t)) {
+                printf("  shape %d, interval %u, time %d\n", shape, interval, i);
+                return;
+            }
+        }
+    }
+    time_ms_t t;
+    CHECK(!one.nextMs(t));
+    CHECK_EQ(block.decodeMs(buf, 37), 0);
+    CHECK_EQ(one.position(), length);
+
+    TimeDecoder seconds(data, length);
+    static time_t whole[COUNT];
+    CHECK_EQ(seconds.decode(whole, COUNT), COUNT);
+    CHECK_EQ(whole[COUNT - 1], (time_t)(times[COUNT - 1] / 1000));
+
+    // a keyframe, a 0 byte, starts the first record and every interval-th after it, and no other
+    for (int k = 0; k < COUNT; k++) {
+        size_t start = k == 0 ? 0 : ends[k - 1];
+        if (!CHECK_EQ(data[start] == 0, k % interval == 0))
+            break;
+    }
+
+    // seekMs() lands on the first time at or after the target, for increasing times
+    if (!backwards) {
+        for (int s = 0; s < 200; s++) {
+            int k = nextRandom() % COUNT;
+            time_ms_t target = expected(k, milliseconds) - (nextRandom() % 3 == 0 ? 1 : 0);
+            int first = 0;
+            while (first < COUNT && expected(first, milliseconds) < target)
+                first++;
+            TimeDecoder seeker(data, length);
+            CHECK(seeker.seekMs(target));
+            CHECK(seeker.nextMs(t));
+            if (!CHECK_EQ(t, expected(first, milliseconds)))
+                break;
+        }
+        TimeDecoder seeker(data, length);
+        CHECK(seeker.seekMs(0));
+        CHECK(seeker.nextMs(t));
+        CHECK_EQ(t, expected(0, milliseconds));
+        CHECK(!seeker.seekMs(expected(COUNT - 1, milliseconds) + 1));
+        CHECK(!seeker.nextMs(t));
+    }
+
+    // cut anywhere, the records that are whole are read and then the decoder stops
+    for (int s = 0; s < 100; s++) {
+        size_t cut = nextRandom() % length;
+        int whole = 0;
+        while (whole < COUNT && ends[whole] <= cut)
+            whole++;
+        TimeDecoder cutDecoder(data, cut);
+        static time_ms_t out[COUNT];
+        CHECK_EQ(cutDecoder.decodeMs(out, COUNT), whole);
+        CHECK_EQ(cutDecoder.position(), whole == 0 ? 0 : ends[whole - 1]);
+    }
+}
+
+int main()
+{
+    static const uint16_t intervals[] = { 1, 7, TIME_CODEC_KEYFRAME, 1000 };
+    for (int shape = 0; shape < 4; shape++) {
+        for (int ms = 0; ms < 2; ms++) {
+            for (size_t k = 0; k < sizeof(intervals) / sizeof(intervals[0]); k++) {
+                checkStream(shape, ms, intervals[k], false);
+                checkStream(shape, ms, intervals[k], true);
+            }
+        }
+    }
+
+    // a steady stream takes one byte a time between keyframes
+    TimeEncoder steady;
+    uint8_t buf[TIME_CODEC_MAX_RECORD];
+    CHECK(steady.encode(1700000000, buf, sizeof(buf)) > 1);
+    CHECK_EQ(steady.encode(1700000200, buf, sizeof(buf)), 2);  // the first change of the difference
+    CHECK_EQ(steady.encode(1700000400, buf, sizeof(buf)), 1);
+    CHECK_EQ(buf[0], 1);
+
+    // no room for the record: nothing written and nothing changes
+    CHECK_EQ(steady.encode(1700000600, buf, 0), 0);
+    CHECK_EQ(steady.encode(1700000600, buf, sizeof(buf)), 1);
+    steady.reset();
+    CHECK_EQ(steady.encode(1700000800, buf, 3), 0);  // a keyframe needs 6 bytes
+    CHECK_EQ(steady.encode(1700000800, buf, sizeof(buf)), 6);
+    CHECK_EQ(buf[0], 0);
+
+    // damaged data: no keyframe first, a varint running past 64 bits, and a delta at the end
+    time_ms_t t;
+    static const uint8_t noKeyframe[] = { 1, 1, 1 };
+    TimeDecoder d1(noKeyframe, sizeof(noKeyframe));
+    CHECK(!d1.nextMs(t));
+    CHECK_EQ(d1.decodeMs(&t, 1), 0);
+    CHECK(!d1.seekMs(0));
+    static const uint8_t overlong[] = { 0, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01 };
+    TimeDecoder d2(overlong, sizeof(overlong));
+    CHECK(!d2.nextMs(t));
+    CHECK_EQ(d2.position(), 0);
+    static const uint8_t unfinished[] = { 0, 2, 0x81 };
+    TimeDecoder d3(unfinished, sizeof(unfinished));
+    CHECK(d3.nextMs(t));
+    CHECK_EQ(t, 1000);
+    CHECK(!d3.nextMs(t));
+    CHECK_EQ(d3.position(), 2);
+    TimeDecoder empty(NULL, 0);
+    CHECK(!empty.nextMs(t));
+    CHECK(!empty.seekMs(0));
+
+    return testResult("codec");
+}
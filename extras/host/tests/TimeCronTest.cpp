@@ -0,0 +1,136 @@
+/* TimeCronTest.cpp
+ * TimeCron next() against a brute force search with matches()
+ *
+ * The search looks at every second of each day that could match. A day is known to match or
+ * not from one time of day that the spec's time fields match, since those do not depend on the
+ * day. Each spec is followed through a chain of next() calls and from random times, and the
+ * result is compared with the first second after the start that matches() accepts.
+ */
+
+#include <Arduino.h>
+#include <TimeLib.h>
+#include "HostTest.h"
+
+static uint32_t seed = 1;
+
+static uint32_t nextRandom()
+{
+    seed = seed * 1664525 + 1013904223;
+    return seed;
+}
+
+struct Spec {
+    const char* spec;
+    uint32_t probe;   // a second of the day the time fields match
+    uint16_t days;    // how far the chain of next() is followed
+};
+
+static const Spec specs[] = {
+    { "* * * * *", 0, 3 },
+    { "*/15 9-17 * * MON-FRI", 9 * 3600, 60 },
+    { "0 0 L * *", 0, 1500 },
+    { "30 23 L 2 *", 23 * 3600 + 1800, 3000 },
+    { "0 12 * * FRIL", 12 * 3600, 1500 },
+    { "0 8 * * MON#1", 8 * 3600, 1500 },
+    { "59 23 * * SUN#5", 23 * 3600 + 59 * 60, 3000 },
+    { "0 0 13 * 5", 0, 1500 },                 // Friday or the 13th, as in cron
+    { "0 6 1,15 * 6#2,0L", 6 * 3600, 1500 },
+    { "*/7 */5 1-10/3 * *", 0, 30 },
+    { "15/20 3 29 2 *", 3 * 3600 + 15 * 60, 3000 },
+    { "0 0 31 */2 *", 0, 3000 },
+    { "*/13 */17 */5 * * *", 0, 4 },           // with seconds
+    { "5 0 0 1 JAN,jul ?", 5, 3000 },
+    { "58-59 59 23 31 12 *", 23 * 3600 + 59 * 60 + 58, 3000 },
+    { "@weekly", 0, 1000 },
+    { "@yearly", 0, 3000 },
+};
+
+// the first matching second after `after`, or 0 if none is found within `days` days
+static uint32_t scanNext(const TimeCron& cron, uint32_t probe, uint32_t after, uint32_t days)
+{
+    uint32_t day = after / 86400;
+    for (uint32_t d = day; d <= day + days && d < 49710; d++) {
+        if (!cron.matches((time_t)d * 86400 + probe))
+            continue;
+        for (uint32_t s = (d == day ? after % 86400 + 1 : 0); s < 86400; s++) {
+            if (cron.matches((time_t)d * 86400 + s))
+                return d * 86400 + s;
+        }
+    }
+    return 0;
+}
+
+static void checkSpec(const Spec& spec)
+{
+    TimeCron cron(spec.spec);
+    if (!CHECK(cron.isValid())) {
+        printf("  \"%s\"\n", spec.spec);
+        return;
+    }
+    CHECK(cron.matches((time_t)scanNext(cron, spec.probe, 1700000000, 3000)));
+
+    // a chain through a few years from 2023, then the same from random times in the range
+    uint32_t t = 1672531200 - 1;
+    uint32_t end = t + spec.days * 86400;
+    while (t < end) {
+        uint32_t expected = scanNext(cron, spec.probe, t, 3000);
+        time_t found = cron.next((time_t)t);
+        if (!CHECK_EQ(found, expected)) {
+            printf("  \"%s\" after %lu\n", spec.spec, (unsigned long)t);
+            return;
+        }
+        t = (uint32_t)found;
+    }
+    for (int i = 0; i < 20; i++) {
+        t = nextRandom() % 4000000000u;
+        uint32_t expected = scanNext(cron, spec.probe, t, 3000);
+        if (!CHECK_EQ(cron.next((time_t)t), expected)) {
+            printf("  \"%s\" after %lu\n", spec.spec, (unsigned long)t);
+            return;
+        }
+    }
+}
+
+int main()
+{
+    for (size_t i = 0; i < sizeof(specs) / sizeof(specs[0]); i++) {
+        checkSpec(specs[i]);
+    }
+
+    // specs that are not understood match nothing
+    static const char* const malformed[] = {
+        "", "* * * *", "* * * * * * *", "60 * * * *", "* 24 * * *", "* * 0 * *", "* * 32 * *",
+        "* * * 13 *", "* * * * 8", "*/0 * * * *", "5-1 * * * *", "* * * * MON#6", "* * * * MON#0",
+        "* * * * MON-FRI#1", "1,,2 * * * *", "1, * * * *", "a * * * *", "* * * JANUARY *", "* * L * L",
+        "* * * * *x", "100 * * * *", "@never", "@daily 0", "0 0 30 2 *x",
+    };
+    for (size_t i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++) {
+        TimeCron cron(malformed[i]);
+        if (!CHECK(!cron.isValid()))
+            printf("  \"%s\"\n", malformed[i]);
+        CHECK(!cron.matches(1700000000));
+        CHECK_EQ(cron.next(1700000000), 0);
+    }
+    TimeCron never("0 0 30 2 *");  // valid, but February never has a 30th
+    CHECK(never.isValid());
+    CHECK_EQ(never.next(1700000000), 0);
+
+    // in a zone, a local time in the hour the clock repeats fires once, on its first pass
+    TimeZone cet("CET-1CEST,M3.5.0,M10.5.0/3");
+    TimeCron daily("30 2 * * *");
+    time_t times[8];
+    CHECK_EQ(daily.fireTimes(1698368400, 1698710400, times, 8, cet), 3);  // Oct 27 01:00 to 31 2023 UTC
+    CHECK_EQ(times[0], 1698453000);  // 02:30 CEST on the 28th
+    CHECK_EQ(times[1], 1698539400);  // 02:30 CEST on the 29th, not again at 02:30 CET
+    CHECK_EQ(times[2], 1698629400);  // 02:30 CET on the 30th
+    TimeCron quarter("*/15 * * * *");
+    time_t day[120];
+    size_t n = quarter.fireTimes(1698530400, 1698620400, day, 120, cet);  // the 25 hours of Oct 29 local
+    CHECK_EQ(n, 96);
+    for (size_t i = 1; i < n; i++) {
+        CHECK(day[i] > day[i - 1]);
+        CHECK(quarter.matches(cet.toLocal(day[i])));
+    }
+
+    return testResult("cron");
+}
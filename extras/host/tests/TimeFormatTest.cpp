@@ -0,0 +1,111 @@
+/* TimeFormatTest.cpp
+ * Compiled TimeFormat output byte for byte against the C library's strftime()
+ *
+ * Every conversion the format compiles itself, the composite ones it expands and those it
+ * leaves to strftime() are checked at random times over the 32 bit range, along with the
+ * output cut to small buffers and a format too long to compile.
+ */
+
+#include <Arduino.h>
+#include <TimeLib.h>
+#include <locale.h>
+#include <string.h>
+#include <time.h>
+#include "HostTest.h"
+
+static uint32_t seed = 1;
+
+static uint32_t nextRandom()
+{
+    seed = seed * 1664525 + 1013904223;
+    return seed;
+}
+
+static const char* const specs[] = {
+    "%a %A %b %B %C %d %e %H %I %j %m %M %p %S %u %U %w %W %y %Y",
+    "%G %g %V",
+    "%c|%D|%x|%F|%r|%R|%T|%X|%h",
+    "%%|%n|%t|literal text",
+    "%Y-%m-%dT%H:%M:%S",
+    "%Ec %Ox %-d %_H %010Y %^a %#b %s %Z",
+    "%",
+    "",
+};
+
+static bool checkFormat(const TimeFormat& format, const char* spec, uint32_t t)
+{
+    time_t local = (time_t)t;
+    struct tm calendar_time;
+    gmtime_r(&local, &calendar_time);
+    char expected[256];
+    size_t expectedLength = strftime(expected, sizeof(expected), spec, &calendar_time);
+
+    char buf[256];
+    size_t length = format.formatTo(buf, sizeof(buf), local, 0);
+    if (CHECK_EQ(length, expectedLength) && CHECK(strcmp(buf, expected) == 0))
+        return true;
+    printf("  \"%s\" at %lu: \"%s\", expected \"%s\"\n", spec, (unsigned long)t, buf, expected);
+    return false;
+}
+
+int main()
+{
+    setlocale(LC_ALL, "C");
+    setenv("TZ", "UTC0", 1);
+    tzset();
+
+    for (size_t i = 0; i < sizeof(specs) / sizeof(specs[0]); i++) {
+        TimeFormat format(specs[i]);
+        CHECK(format.isComplete());
+        // the ends of the range, the turns of the ISO week years and random times
+        static const uint32_t fixed[] = { 0, 0xFFFFFFFF, 1230681600, 1262217600, 1293753600, 4102444799u };
+        for (size_t j = 0; j < sizeof(fixed) / sizeof(fixed[0]); j++) {
+            checkFormat(format, specs[i], fixed[j]);
+        }
+        for (int j = 0; j < 20000; j++) {
+            if (!checkFormat(format, specs[i], nextRandom()))
+                break;
+        }
+    }
+
+    // cut to the buffer as snprintf(), with the length of the whole output
+    TimeFormat iso("%Y-%m-%d %H:%M:%S");
+    char buf[8];
+    CHECK_EQ(iso.formatTo(buf, sizeof(buf), 1700000000, 0), 19);
+    CHECK(strcmp(buf, "2023-11") == 0);
+    CHECK_EQ(iso.formatTo(buf, 0, 1700000000, 0), 19);
+
+    // the offset in %z, "Z" at UTC
+    TimeFormat zoned("%H:%M%z");
+    char text[32];
+    zoned.formatTo(text, sizeof(text), 1700000000, 0);
+    CHECK(strcmp(text, "22:13Z") == 0);
+    zoned.formatTo(text, sizeof(text), 1700000000 + 19800, 19800);
+    CHECK(strcmp(text, "03:43+05:30") == 0);
+
+    // a format that does not fit is refused and writes nothing rather than a part of it
+    char longSpec[200];
+    for (int i = 0; i < 99; i++) {
+        memcpy(&longSpec[2 * i], "%S", 2);
+    }
+    longSpec[198] = 0;
+    TimeFormat tooLong(longSpec);
+    CHECK(!tooLong.isComplete());
+    CHECK_EQ(tooLong.formatTo(text, sizeof(text), 1700000000, 0), 0);
+    CHECK(text[0] == 0);
+    CHECK(!tooLong.set(longSpec + 4));  // one operation over
+    CHECK(tooLong.set(longSpec + 6));   // TIME_FORMAT_CODE_SIZE operations
+    CHECK(tooLong.isComplete());
+    CHECK_EQ(tooLong.formatTo(text, sizeof(text), 1700000000, 0), 2 * TIME_FORMAT_CODE_SIZE);
+
+    CHECK(!Time.setFormat(longSpec));
+    CHECK_EQ(Time.formatTo(text, sizeof(text), 1700000000), 0);
+    CHECK(Time.setFormat("%H:%M"));
+    CHECK_EQ(Time.formatTo(text, sizeof(text), 1700000000), 5);
+
+    TimeStamper stamper;
+    CHECK(!stamper.set(longSpec));
+    CHECK(strcmp(stamper.stamp(1700000000), "") == 0);
+
+    return testResult("format");
+}
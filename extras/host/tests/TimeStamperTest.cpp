@@ -0,0 +1,102 @@
+/* TimeStamperTest.cpp
+ * TimeStamper text against a full TimeFormat render of the same time
+ *
+ * The stamper patches only the digits that changed since the last time, so it is stepped
+ * second by second and in larger jumps through days and the DST changes of a zone, and each
+ * text is compared with what the compiled format writes from scratch.
+ */
+
+#include <Arduino.h>
+#include <TimeLib.h>
+#include <string.h>
+#include "HostTest.h"
+
+static uint32_t seed = 1;
+
+static uint32_t nextRandom()
+{
+    seed = seed * 1664525 + 1013904223;
+    return seed;
+}
+
+static const char* const specs[] = {
+    TIME_FORMAT_ISO8601_FULL,
+    "%H:%M:%S",
+    "%I:%M:%S %p on %a %d %b",
+    "%T %r",                   // expanded composites
+    "%H:%M:%S %Z",             // left to strftime(), rendered every time
+    "%Y-%m-%d %H:%M:%S %A %B %d %Y-%m-%d %H:%M:%S %A %B %d",  // cut to TIME_STAMP_SIZE
+    "%S%S%S%S%S%S%S%S%S",      // more fields than TIME_STAMP_FIELDS
+};
+
+static bool checkStamp(TimeStamper& stamper, const TimeFormat& format, const char* spec, uint32_t t)
+{
+    char expected[128];
+    size_t expectedLength = Time.formatTo(expected, sizeof(expected), t, format);
+    if (expectedLength >= TIME_STAMP_SIZE)
+        expected[TIME_STAMP_SIZE - 1] = 0;
+    const char* text = stamper.stamp(t);
+    if (CHECK_EQ(stamper.length(), expectedLength) && CHECK(strcmp(text, expected) == 0))
+        return true;
+    printf("  \"%s\" at %lu: \"%s\", expected \"%s\"\n", spec, (unsigned long)t, text, expected);
+    return false;
+}
+
+static void checkSpec(const char* spec)
+{
+    TimeStamper stamper(spec);
+    TimeFormat format(spec);
+    CHECK(format.isComplete());
+
+    // a second at a time through both changes of 2023 and a midnight
+    static const uint32_t starts[] = { 1679792400 - 4000, 1698541200 - 4000, 1700002800 - 4000 };
+    for (size_t i = 0; i < sizeof(starts) / sizeof(starts[0]); i++) {
+        for (uint32_t t = starts[i]; t < starts[i] + 8000; t++) {
+            if (!checkStamp(stamper, format, spec, t))
+                return;
+        }
+    }
+
+    // jumps of up to a day, forwards and now and then backwards, over the whole range
+    uint32_t t = 0;
+    for (int i = 0; i < 200000; i++) {
+        uint32_t r = nextRandom();
+        uint32_t step = (r >> 8) % ((r & 3) == 0 ? 86400 : (r & 3) == 1 ? 3600 : 90);
+        if ((r & 0xF0) == 0 && t > step)
+            t -= step;
+        else if (t <= 0xFFFFFFFF - step)
+            t += step;
+        else
+            t = 0;
+        if (!checkStamp(stamper, format, spec, t))
+            return;
+    }
+
+    // stampTo() copies and cuts as formatTo() does
+    char buf[6];
+    size_t length = stamper.stampTo(buf, sizeof(buf), 1700000000);
+    CHECK_EQ(length, stamper.length());
+    CHECK(strncmp(buf, stamper.stamp(1700000000), 5) == 0 && buf[5] == 0);
+}
+
+int main()
+{
+    CHECK(Time.setTimeZone("CET-1CEST,M3.5.0,M10.5.0/3"));
+    for (size_t i = 0; i < sizeof(specs) / sizeof(specs[0]); i++) {
+        checkSpec(specs[i]);
+    }
+
+    // a zone whose DST is half an hour, so the minutes change with the offset on the same day
+    CHECK(Time.setTimeZone("LHST-10:30LHDT-11,M10.1.0,M4.1.0"));
+    for (size_t i = 0; i < 3; i++) {
+        checkSpec(specs[i]);
+    }
+
+    // set() starts over with the new format
+    TimeStamper stamper("%H:%M:%S");
+    stamper.stamp(1700000000);
+    CHECK(stamper.set("%M:%S"));
+    CHECK(strcmp(stamper.stamp(1700000000), "13:20") == 0);
+
+    return testResult("stamper");
+}
@@ -0,0 +1,153 @@
+/* TimeWheelTest.cpp
+ * TimeWheel alarms against the fake millis() of the host build: when they fire, and what a
+ * step of the clock does to them
+ */
+
+#include <Arduino.h>
+#include <TimeLib.h>
+#include "HostTest.h"
+
+struct Fired {
+    int    count;
+    time_t last;   // now() when it last fired
+};
+
+static void record(void* context)
+{
+    Fired* f = (Fired*)context;
+    f->count++;
+    f->last = TimeClass::now();
+}
+
+static TimeWheel wheel;
+
+// run the clock a second at a time, servicing the wheel each second as loop() would
+static void runSeconds(uint32_t seconds)
+{
+    for (uint32_t i = 0; i < seconds; i++) {
+        advanceHostMillis(1000);
+        wheel.service();
+    }
+}
+
+// alarms that cancel each other when they fire
+static TimeAlarm pair[2];
+static Fired pairFired[2];
+
+static void cancelOther(void* context)
+{
+    int i = (int)(intptr_t)context;
+    pairFired[i].count++;
+    wheel.cancel(pair[1 - i]);
+}
+
+static TimeAlarm self;
+static int selfFired = 0;
+
+static void cancelSelf(void*)
+{
+    if (++selfFired == 3)
+        wheel.cancel(self);
+}
+
+int main()
+{
+    const time_t start = 1700000000;  // 22:13:20, not on a minute
+    setHostMillis(0);
+    TimeClass::setTime(start);
+
+    // alarms fire at their second, one at a time of the clock and after a duration alike
+    TimeAlarm atAlarm, afterAlarm, everyAlarm, dayAlarm;
+    Fired atFired = {}, afterFired = {}, everyFired = {}, dayFired = {};
+    wheel.at(atAlarm, start + 5, record, &atFired);
+    wheel.after(afterAlarm, 100, record, &afterFired);
+    wheel.every(everyAlarm, 7, record, &everyFired);
+    wheel.at(dayAlarm, start + 2 * SECS_PER_DAY + 17, record, &dayFired);  // through the hours and days levels
+    CHECK_EQ(wheel.count(), 4);
+    runSeconds(4);
+    CHECK_EQ(atFired.count, 0);
+    runSeconds(1);
+    CHECK_EQ(atFired.count, 1);
+    CHECK_EQ(atFired.last, start + 5);
+    CHECK(!atAlarm.isScheduled());
+    runSeconds(95);
+    CHECK_EQ(afterFired.count, 1);
+    CHECK_EQ(afterFired.last, start + 100);
+    CHECK_EQ(everyFired.count, 14);
+    CHECK_EQ(everyFired.last, start + 98);
+    wheel.cancel(everyAlarm);
+    CHECK_EQ(wheel.count(), 1);
+
+    // a long wait is serviced at once, without visiting every second
+    advanceHostMillis(2 * SECS_PER_DAY * 1000);
+    CHECK_EQ(wheel.service(), 1);
+    CHECK_EQ(dayFired.count, 1);
+    CHECK_EQ(wheel.count(), 0);
+
+    // a step forward: alarms at a time stay put and the skipped ones fire once, a repeating
+    // alarm fires once for all the periods it missed; alarms after a duration move with the step
+    time_t t = TimeClass::now();
+    TimeAlarm repeatAlarm;
+    Fired repeatFired = {};
+    atFired = afterFired = everyFired = Fired();
+    wheel.at(atAlarm, t + 50, record, &atFired);
+    wheel.repeat(repeatAlarm, t + 10, 10, record, &repeatFired);
+    wheel.after(afterAlarm, 60, record, &afterFired);
+    wheel.every(everyAlarm, 30, record, &everyFired);
+    runSeconds(5);
+    TimeClass::adjustTime(3600);
+    CHECK_EQ(wheel.service(), 2);
+    CHECK_EQ(atFired.count, 1);
+    CHECK_EQ(repeatFired.count, 1);
+    CHECK_EQ(repeatAlarm.time(), t + 3610);  // the next period after the new time
+    CHECK_EQ(afterAlarm.time(), t + 3660);
+    CHECK_EQ(everyAlarm.time(), t + 3630);
+    runSeconds(54);
+    CHECK_EQ(afterFired.count, 0);
+    CHECK_EQ(everyFired.count, 1);
+    CHECK_EQ(everyFired.last, t + 3630);
+    runSeconds(1);
+    CHECK_EQ(afterFired.count, 1);
+    CHECK_EQ(afterFired.last, t + 3660);
+    CHECK_EQ(repeatFired.count, 7);  // once for the step, then every 10 seconds from t + 3610
+    wheel.cancel(repeatAlarm);
+    wheel.cancel(everyAlarm);
+
+    // a step back: alarms at a time wait for the clock to get there again and nothing fires
+    // twice; alarms after a duration still wait as long
+    t = TimeClass::now();
+    atFired = afterFired = repeatFired = Fired();
+    wheel.at(atAlarm, t + 20, record, &atFired);
+    wheel.after(afterAlarm, 20, record, &afterFired);
+    wheel.repeat(repeatAlarm, t + 5, 60, record, &repeatFired);
+    runSeconds(5);
+    CHECK_EQ(repeatFired.count, 1);
+    TimeClass::setTime(t - 100 + 5);
+    runSeconds(20);
+    CHECK_EQ(afterFired.count, 1);
+    CHECK_EQ(afterFired.last, t - 100 + 20);  // 15 seconds after the step, 20 after it was scheduled
+    CHECK_EQ(atFired.count, 0);
+    CHECK_EQ(repeatFired.count, 1);
+    CHECK_EQ(repeatAlarm.time(), t + 65);
+    runSeconds(95);
+    CHECK_EQ(atFired.count, 1);
+    CHECK_EQ(atFired.last, t + 20);
+    CHECK_EQ(repeatFired.count, 1);
+    wheel.cancel(repeatAlarm);
+    CHECK_EQ(wheel.count(), 0);
+
+    // cancelling while service() fires: of two alarms due together only the first fires, and
+    // a repeating alarm that cancels itself stops
+    t = TimeClass::now();
+    wheel.at(pair[0], t + 3, cancelOther, (void*)0);
+    wheel.at(pair[1], t + 3, cancelOther, (void*)1);
+    wheel.every(self, 2, cancelSelf);
+    runSeconds(3);
+    CHECK_EQ(pairFired[0].count + pairFired[1].count, 1);
+    CHECK(!pair[0].isScheduled() && !pair[1].isScheduled());
+    runSeconds(10);
+    CHECK_EQ(selfFired, 3);
+    CHECK(!self.isScheduled());
+    CHECK_EQ(wheel.count(), 0);
+    return testResult("wheel");
+}
@@ -0,0 +1,162 @@
+/* TimeZoneTest.cpp
+ * TimeZone offsets against the C library's localtime_r() for the same POSIX TZ string
+ *
+ * The zone caches the transitions of the year last looked up, so the times are checked in
+ * orders that move the cache forwards, backwards and between the ends of the 32 bit range.
+ */
+
+#include <Arduino.h>
+#include <TimeLib.h>
+#include <stdlib.h>
+#include <time.h>
+#include "HostTest.h"
+
+// the offset the C library gives at utc for the zone in TZ
+static long libcOffset(uint32_t utc)
+{
+    time_t t = (time_t)utc;
+    struct tm local;
+    localtime_r(&t, &local);
+    return local.tm_gmtoff;
+}
+
+static void useZone(const char* tz)
+{
+    setenv("TZ", tz, 1);
+    tzset();
+}
+
+static bool checkOffset(const TimeZone& zone, const char* tz, uint32_t utc)
+{
+    long expected = libcOffset(utc);
+    if (CHECK_EQ(zone.offset(utc), expected))
+        return true;
+    printf("  %s at %lu\n", tz, (unsigned long)utc);
+    return false;
+}
+
+static uint32_t seed = 1;
+
+static uint32_t nextRandom()
+{
+    seed = seed * 1664525 + 1013904223;
+    return seed;
+}
+
+// a random transition rule: Mm.w.d, Jn or n, with a time that may be negative or past the day
+static void randomRule(char* p, size_t size)
+{
+    size_t n;
+    uint32_t r = nextRandom();
+    switch (r % 3) {
+    case 0: n = snprintf(p, size, ",M%u.%u.%u", 1 + (r >> 2) % 12, 1 + (r >> 6) % 5, (r >> 9) % 7); break;
+    case 1: n = snprintf(p, size, ",J%u", 1 + (r >> 2) % 365); break;
+    default: n = snprintf(p, size, ",%u", (r >> 2) % 366); break;
+    }
+    r = nextRandom();
+    switch (r % 4) {
+    case 0: break;  // 02:00
+    case 1: snprintf(p + n, size - n, "/%u", (r >> 2) % 25); break;
+    case 2: snprintf(p + n, size - n, "/%s%u:%02u", (r & 4) ? "-" : "", (r >> 3) % 168, (r >> 11) % 60); break;
+    default: snprintf(p + n, size - n, "/%u", 160 + (r >> 2) % 8); break;
+    }
+}
+
+// a zone with a random offset, daylight saving offset and rules
+static void randomZone(char* tz, size_t size)
+{
+    uint32_t r = nextRandom();
+    int hours = (int)(r % 25) - 12;
+    size_t n = snprintf(tz, size, "<STD>%d:%02u<DST>", hours, (r >> 5) % 2 * 30);
+    if (r & 0x400)
+        n += snprintf(tz + n, size - n, "%d", hours - 1 - (int)((r >> 11) % 2));
+    randomRule(tz + n, size - n);
+    n = strlen(tz);
+    randomRule(tz + n, size - n);
+}
+
+// random times and the times around the transitions of random years, in a random order so the
+// cache moves between years in both directions
+static void checkZone(const char* tz)
+{
+    useZone(tz);
+    TimeZone zone;
+    if (!CHECK(zone.set(tz))) {
+        printf("  %s is not understood\n", tz);
+        return;
+    }
+    for (int i = 0; i < 200; i++) {
+        uint32_t t = nextRandom();
+        if (!checkOffset(zone, tz, t))
+            return;
+        for (int d = -2; d <= 2; d++) {
+            // the start of the year, where a transition of the neighbouring year can fall
+            uint32_t newYear = (uint32_t)calendarToTime(timeYear(t), 1, 1);
+            if (!checkOffset(zone, tz, newYear + d * 3600 * 25))
+                return;
+        }
+    }
+    // find each change of the offset in a random year and check the seconds around it
+    uint32_t year = 1971 + nextRandom() % 134;
+    uint32_t t = (uint32_t)calendarToTime(year, 1, 1) - 8 * SECS_PER_DAY;
+    long last = libcOffset(t);
+    for (uint32_t end = t + 382 * SECS_PER_DAY; t < end; t += 1800) {
+        long o = libcOffset(t);
+        if (o != last) {
+            for (uint32_t u = t - 1800; u <= t; u++) {
+                if (!checkOffset(zone, tz, u))
+                    return;
+            }
+            last = o;
+        }
+    }
+}
+
+int main()
+{
+    static const char* const zones[] = {
+        "CET-1CEST,M3.5.0,M10.5.0/3",
+        "EST5EDT,M3.2.0,M11.1.0",
+        "AEST-10AEDT,M10.1.0,M4.1.0/3",
+    };
+    for (const char* tz : zones) {
+        useZone(tz);
+        TimeZone zone(tz);
+
+        // the last year of the range, then the first: the cached year must not reach across
+        static const uint32_t ends[] = { 0xFFFFFFFFUL, 4290000000UL, 7072590, 24140090, 0, 3600, 0xFFFFFFFFUL - 3600 };
+        for (uint32_t t : ends)
+            checkOffset(zone, tz, t);
+        for (uint32_t t = 0xFFFFFFFFUL - 40 * SECS_PER_DAY; t != 0 && t >= 0xFFFFFFFFUL - 40 * SECS_PER_DAY; t += 3599)
+            checkOffset(zone, tz, t);
+        for (uint32_t t = 0; t < 400 * SECS_PER_DAY; t += 3599)
+            checkOffset(zone, tz, t);
+        for (uint32_t t = 0xFFFFFFFFUL; t > 0xFFFFFFFFUL - 400 * SECS_PER_DAY; t -= 3599) {
+            checkOffset(zone, tz, t);
+            checkOffset(zone, tz, 0xFFFFFFFFUL - t);
+        }
+    }
+
+    // southern hemisphere zones, Jn and n rules, times past midnight and before it
+    static const char* const rules[] = {
+        "NZST-12NZDT,M9.5.0,M4.1.0/3",
+        "<-03>3<-02>,M3.5.0/-2,M10.5.0/-1",
+        "<-04>4<-03>,M9.1.6/24,M4.1.6/24",
+        "IST-2IDT,M3.4.4/26,M10.5.0",
+        "<+0330>-3:30<+0430>,J79/24,J263/24",
+        "EST5EDT,J60,J300/1:30",
+        "EST5EDT,59,300",
+        "WART4WARST,J1/0,J365/25",
+        "CET-1CEST,J365/25,J60/167",
+        "XXX3YYY,365/25,0/-20",
+        "AAA-10BBB,M1.1.0/-167,M12.5.6/167",
+    };
+    for (const char* tz : rules)
+        checkZone(tz);
+    for (int i = 0; i < 300; i++) {
+        char tz[64];
+        randomZone(tz, sizeof(tz));
+        checkZone(tz);
+    }
+    return testResult("time zone");
+}